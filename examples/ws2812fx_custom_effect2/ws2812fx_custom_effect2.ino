@@ -55,7 +55,7 @@ void setup() {
   ws2812fx.setBrightness(255);
 
   // setup the custom effects
-  uint8_t dualLarsonMode  = ws2812fx.setCustomMode(F("Dual Larson"), dualLarson);
+  uint8_t dualLarsonMode  = ws2812fx.setCustomMode(F("Dual Larson"), dualLarson, sizeof(DualLarsonState));
 
   uint32_t colors[] = {RED, BLUE, WHITE};
 
@@ -0,0 +1,43 @@
+/*
+  Arduino.cpp - virtual clock and random() for the host build.
+*/
+
+#include "Arduino.h"
+
+static uint64_t _clock_us = 0;
+static uint32_t _random_seed = 1;
+
+unsigned long millis(void) {
+  return (uint32_t)(_clock_us / 1000); // rolls over every 49 days, like the real thing
+}
+
+unsigned long micros(void) {
+  return (uint32_t)_clock_us;
+}
+
+void hostClockSet(uint64_t us) {
+  _clock_us = us;
+}
+
+void hostClockAdvance(uint64_t us) {
+  _clock_us += us;
+}
+
+uint64_t hostClock(void) {
+  return _clock_us;
+}
+
+void randomSeed(unsigned long seed) {
+  if(seed != 0) _random_seed = seed;
+}
+
+long random(long howbig) {
+  if(howbig <= 0) return 0;
+  _random_seed = _random_seed * 1103515245 + 12345;
+  return (long)((_random_seed >> 1) % (uint32_t)howbig);
+}
+
+long random(long howsmall, long howbig) {
+  if(howsmall >= howbig) return howsmall;
+  return random(howbig - howsmall) + howsmall;
+}
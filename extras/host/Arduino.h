@@ -0,0 +1,59 @@
+/*
+  Arduino.h - minimal stand-in for the Arduino/Teensyduino core, just enough
+  to compile WS2812FX on a Linux host.
+
+  Time is virtual: millis() and micros() only move when the host program
+  calls hostClockSet() or hostClockAdvance(), so effects can be stepped
+  frame by frame and profiled without waiting on a wall clock.
+*/
+
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <type_traits>
+
+#include "binary.h"
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define PROGMEM
+#define DMAMEM
+#define EXTMEM
+#define FASTRUN
+#define pgm_read_byte(addr) (*(const uint8_t *)(addr))
+
+class __FlashStringHelper;
+#define F(string_literal) (reinterpret_cast<const __FlashStringHelper *>(string_literal))
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+template<class A, class B> inline typename std::common_type<A, B>::type min(A a, B b) {
+  return (b < a) ? b : a;
+}
+
+template<class A, class B> inline typename std::common_type<A, B>::type max(A a, B b) {
+  return (a < b) ? b : a;
+}
+
+inline long map(long x, long in_min, long in_max, long out_min, long out_max) {
+  return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
+}
+
+// virtual clock
+unsigned long millis(void);
+unsigned long micros(void);
+void hostClockSet(uint64_t us);
+void hostClockAdvance(uint64_t us);
+uint64_t hostClock(void);
+
+// deterministic replacement for the core's random()
+void randomSeed(unsigned long seed);
+long random(long howbig);
+long random(long howsmall, long howbig);
+
+#endif
@@ -0,0 +1,66 @@
+/*
+  WS2812Serial.cpp - host stand-in for Paul Stoffregen's WS2812Serial library.
+*/
+
+#include "WS2812Serial.h"
+
+bool WS2812Serial::begin()
+{
+  return true;
+}
+
+void WS2812Serial::show()
+{
+  // a blocking wait for the previous transfer costs virtual time
+  if (hostClock() < transferEnd) hostClockSet(transferEnd);
+
+  // copy drawing buffer to frame buffer, same encoding as the real library
+  const uint8_t *p = drawBuffer;
+  const uint8_t *end = p + (numled * ((config < 6) ? 3 : 4));
+  uint8_t *fb = frameBuffer;
+  const uint32_t mult = brightness + 1;
+  while (p < end) {
+    uint8_t b = *p++;
+    uint8_t g = *p++;
+    uint8_t r = *p++;
+    uint8_t w = 0;
+    if (config >= 6) w = *p++;
+    b = (b * mult) >> 8;
+    g = (g * mult) >> 8;
+    r = (r * mult) >> 8;
+    w = (w * mult) >> 8;
+    uint32_t n = 0;
+    switch (config) {
+      case WS2812_RGB:  n = (r << 16) | (g << 8) | b; break;
+      case WS2812_RBG:  n = (r << 16) | (b << 8) | g; break;
+      case WS2812_GRB:  n = (g << 16) | (r << 8) | b; break;
+      case WS2812_GBR:  n = (g << 16) | (b << 8) | r; break;
+      case WS2812_BRG:  n = (b << 16) | (r << 8) | g; break;
+      case WS2812_BGR:  n = (b << 16) | (g << 8) | r; break;
+      case WS2812_RGBW: n = (r << 24) | (g << 16) | (b << 8) | w; break;
+      case WS2812_RBGW: n = (r << 24) | (b << 16) | (g << 8) | w; break;
+      case WS2812_GRBW: n = (g << 24) | (r << 16) | (b << 8) | w; break;
+      case WS2812_GBRW: n = (g << 24) | (b << 16) | (r << 8) | w; break;
+      case WS2812_BRGW: n = (b << 24) | (r << 16) | (g << 8) | w; break;
+      case WS2812_BGRW: n = (b << 24) | (g << 16) | (r << 8) | w; break;
+    }
+    const uint8_t *stop = fb + ((config < 6) ? 12 : 16);
+    if (config < 6) n <<= 8;
+    do {
+      uint8_t x = 0x08;
+      if (!(n & 0x80000000)) x |= 0x07;
+      if (!(n & 0x40000000)) x |= 0xE0;
+      n <<= 2;
+      *fb++ = x;
+    } while (fb < stop);
+  }
+
+  // 1.25 us per bit plus 300 us reset time
+  transferEnd = hostClock() + numled * ((config < 6) ? 30 : 40) + 300;
+  showCount++;
+}
+
+bool WS2812Serial::busy()
+{
+  return hostClock() < transferEnd;
+}
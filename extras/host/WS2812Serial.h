@@ -0,0 +1,124 @@
+/*
+  WS2812Serial.h - host stand-in for Paul Stoffregen's WS2812Serial library.
+
+  Mirrors the public interface of the real library. show() performs the same
+  brightness scaling and UART bit encoding into the frame buffer, so its cost
+  is representative, but instead of starting a DMA transfer it only records
+  when the (virtual) transfer would finish. busy() reports that state against
+  the virtual clock.
+*/
+
+#ifndef WS2812Serial_h
+#define WS2812Serial_h
+
+#include <Arduino.h>
+
+#define WS2812_RGB      0  // The WS2811 datasheet documents this way
+#define WS2812_RBG      1
+#define WS2812_GRB      2  // Most LED strips are wired this way
+#define WS2812_GBR      3
+#define WS2812_BRG      4
+#define WS2812_BGR      5
+#define WS2812_RGBW     6
+#define WS2812_RBGW     7
+#define WS2812_GRBW     8
+#define WS2812_GBRW     9
+#define WS2812_BRGW     10
+#define WS2812_BGRW     11
+
+class WS2812Serial
+{
+public:
+  WS2812Serial(uint16_t num, void *fb, void *db, uint8_t pin, uint8_t cfg) :
+    numled(num), pin(pin), config(cfg),
+    frameBuffer((uint8_t *)fb), drawBuffer((uint8_t *)db) {
+  }
+  bool begin();
+  void setPixel(uint32_t num, int color) {
+    if (num >= numled) return;
+    if (config < 6) {
+      num *= 3;
+      drawBuffer[num+0] = color & 255;
+      drawBuffer[num+1] = (color >> 8) & 255;
+      drawBuffer[num+2] = (color >> 16) & 255;
+    } else {
+      num *= 4;
+      drawBuffer[num+0] = color & 255;
+      drawBuffer[num+1] = (color >> 8) & 255;
+      drawBuffer[num+2] = (color >> 16) & 255;
+      drawBuffer[num+3] = (color >> 24) & 255;
+    }
+  }
+  void setPixel(uint32_t num, uint8_t red, uint8_t green, uint8_t blue) {
+    if (num >= numled) return;
+    if (config < 6) {
+      num *= 3;
+      drawBuffer[num+0] = blue;
+      drawBuffer[num+1] = green;
+      drawBuffer[num+2] = red;
+    } else {
+      num *= 4;
+      drawBuffer[num+0] = blue;
+      drawBuffer[num+1] = green;
+      drawBuffer[num+2] = red;
+      drawBuffer[num+3] = 0;
+    }
+  }
+  void setPixel(uint32_t num, uint8_t red, uint8_t green, uint8_t blue, uint8_t white) {
+    if (num >= numled) return;
+    if (config < 6) {
+      num *= 3;
+      drawBuffer[num+0] = blue;
+      drawBuffer[num+1] = green;
+      drawBuffer[num+2] = red;
+    } else {
+      num *= 4;
+      drawBuffer[num+0] = blue;
+      drawBuffer[num+1] = green;
+      drawBuffer[num+2] = red;
+      drawBuffer[num+3] = white;
+    }
+  }
+  void clear() {
+    memset(drawBuffer, 0, numled * ((config < 6) ? 3 : 4));
+  }
+  void show();
+  bool busy();
+  uint16_t numPixels() const {
+    return numled;
+  }
+
+  // Functions for quick compatibility with Adafruit_NeoPixel
+  void setPixelColor(uint16_t num, uint32_t color) {
+    setPixel(num, color);
+  }
+  void setPixelColor(uint16_t num, uint8_t red, uint8_t green, uint8_t blue) {
+    setPixel(num, red, green, blue);
+  }
+  void setPixelColor(uint16_t num, uint8_t red, uint8_t green, uint8_t blue, uint8_t white) {
+    setPixel(num, red, green, blue, white);
+  }
+  void setBrightness(uint8_t n) {
+    brightness = n;
+  }
+  uint8_t getBrightness() {
+    return brightness;
+  }
+
+  // host only: number of show() calls that reached the (virtual) wire
+  uint32_t hostShowCount() const {
+    return showCount;
+  }
+
+private:
+  const uint16_t numled;
+  const uint8_t pin;
+  const uint8_t config;
+  uint8_t *frameBuffer;
+  uint8_t *drawBuffer;
+  uint8_t brightness = 255;
+  uint64_t transferEnd = 0;
+  uint32_t showCount = 0;
+};
+
+#endif
@@ -0,0 +1,89 @@
+/*
+  bench.cpp - frame time benchmark for every builtin mode and custom effect.
+
+  usage: bench [-w] [-r] [-f frames] [name filter]
+
+  Runs each effect on a single segment of 60, 300, 1500 and 8000 LEDs, with
+  and without the GAMMA and REVERSE options, and prints one CSV line per run:
+    mode,name,leds,options,frames,ns_per_frame,ns_per_led
+
+  Only service() calls that actually render a frame (including show()) are
+  timed. -w benchmarks an RGBW strip instead of RGB, -r times rendering only
+  (show() is replaced by a no-op), -f sets the number of frames rendered per
+  run at 300 LEDs (scaled by LED count, default 2000).
+*/
+
+#include <stdio.h>
+#include <chrono>
+
+#include "host.h"
+#include "custom_effects.h"
+
+static const uint16_t _led_counts[] = { 60, 300, 1500, 8000 };
+
+static const uint8_t _options[] = { NO_OPTIONS, GAMMA, REVERSE, GAMMA | REVERSE };
+static const char* _option_names[] = { "none", "GAMMA", "REVERSE", "GAMMA|REVERSE" };
+
+static void bench(uint8_t mode, const char* name, uint16_t numLeds, uint8_t optIndex, uint32_t numFrames) {
+  ws2812fx.setSegment(0, 0, numLeds - 1, mode, COLORS(RED, GREEN, BLUE), 1000, _options[optIndex]);
+  ws2812fx.start();
+  for(uint8_t i=0; i < 10; i++) hostServiceFrame(); // warm up
+
+  uint32_t frames = 0;
+  double ns = 0;
+  while(frames < numFrames) {
+    hostClockAdvance(1000);
+    std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+    bool rendered = ws2812fx.service();
+    std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+    if(rendered) {
+      ns += std::chrono::duration<double, std::nano>(t1 - t0).count();
+      frames++;
+    }
+  }
+
+  printf("%u,\"%s\",%u,%s,%u,%.0f,%.2f\n", mode, name, numLeds, _option_names[optIndex],
+    frames, ns / frames, ns / frames / numLeds);
+  fflush(stdout);
+}
+
+int main(int argc, char** argv) {
+  uint8_t type = WS2812_GRB;
+  bool renderOnly = false;
+  uint32_t baseFrames = 2000;
+  const char* filter = NULL;
+
+  for(int i=1; i < argc; i++) {
+    if(strcmp(argv[i], "-w") == 0) type = WS2812_GRBW;
+    else if(strcmp(argv[i], "-r") == 0) renderOnly = true;
+    else if(strcmp(argv[i], "-f") == 0 && i + 1 < argc) baseFrames = atol(argv[++i]);
+    else filter = argv[i];
+  }
+
+  printf("mode,name,leds,options,frames,ns_per_frame,ns_per_led\n");
+
+  for(uint8_t l=0; l < sizeof(_led_counts)/sizeof(_led_counts[0]); l++) {
+    uint16_t numLeds = _led_counts[l];
+    uint32_t numFrames = max(20UL, (unsigned long)baseFrames * 300 / numLeds);
+
+    hostStrip(numLeds, type);
+    initCustomEffects();
+    if(renderOnly) ws2812fx.setCustomShow([]{ return; });
+    ws2812fx.setBrightness(255);
+
+    for(uint8_t o=0; o < sizeof(_options); o++) {
+      for(uint8_t m=0; m < FX_MODE_CUSTOM_0; m++) {
+        const char* name = (const char*)ws2812fx.getModeName(m);
+        if(filter && !strstr(name, filter)) continue;
+        bench(m, name, numLeds, o, numFrames);
+      }
+      for(uint8_t c=0; c < CUSTOM_EFFECT_COUNT; c++) {
+        const char* name = _custom_effects[c].name;
+        if(filter && !strstr(name, filter)) continue;
+        uint8_t m = ws2812fx.setCustomMode(0, F(name), _custom_effects[c].mode, _custom_effects[c].stateSize);
+        bench(m, name, numLeds, o, numFrames);
+      }
+    }
+  }
+  return 0;
+}
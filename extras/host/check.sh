@@ -0,0 +1,16 @@
+#!/bin/sh
+# check.sh - run fxrun over every mode, with each of a few option sets and
+# brightnesses, and print one line per run with the show count and pixel
+# hash (wall time stripped). `make check` compares this to check_hashes.txt;
+# `make check-update` re-records it after an intended output change.
+
+FXRUN=${1:-./build/fxrun}
+
+$FXRUN -l | while IFS= read -r mode; do
+  for options in 0x00 0x08 0x80 0x88 0x32 0x01; do
+    for brightness in 255 64; do
+      printf '%s %s ' "$options" "$brightness"
+      $FXRUN "$mode" 150 300 "$options" "$brightness" | sed 's/, [0-9]* ns\/frame//' || echo "FAILED: $mode"
+    done
+  done
+done
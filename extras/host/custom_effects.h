@@ -0,0 +1,70 @@
+/*
+  custom_effects.h - pulls every effect in src/custom into the host build
+  and lists them in a table, so host programs can register them by name.
+
+  The custom effects are passed the WS2812FX instance they run on, so the
+  table can be registered with any instance.
+*/
+
+#ifndef custom_effects_h
+#define custom_effects_h
+
+#include <WS2812FX.h>
+
+#include "custom/Bits.h"
+#include "custom/BlockDissolve.h"
+#include "custom/DualLarson.h"
+#include "custom/Fillerup.h"
+#include "custom/Heartbeat.h"
+#include "custom/ICU.h"
+#include "custom/Matrix.h"
+#include "custom/MultiComet.h"
+#include "custom/Oscillate.h"
+#include "custom/Popcorn.h"
+#include "custom/Rain.h"
+#include "custom/RainbowFireworks.h"
+#include "custom/RainbowLarson.h"
+#include "custom/RandomChase.h"
+#include "custom/TriFade.h"
+#include "custom/TwinkleFox.h"
+#include "custom/VUMeter.h"
+
+typedef struct CustomEffect {
+  const char* name;
+  WS2812FX::custom_mode_ptr mode;
+  uint16_t stateSize; // per segment state (see WS2812FX::getModeState())
+} custom_effect;
+
+static const custom_effect _custom_effects[] = {
+  { "Bits",              bits,             0 },
+  { "Block Dissolve",    blockDissolve,    0 },
+  { "Dual Larson",       dualLarson,       sizeof(DualLarsonState) },
+  { "Fillerup",          fillerup,         0 },
+  { "Heartbeat",         heartbeat,        sizeof(HeartbeatState) },
+  { "ICU",               icu,              0 },
+  { "Matrix",            matrix,           0 },
+  { "Multi Comet",       multiComet,       sizeof(MultiCometState) },
+  { "Oscillate",         oscillate,        sizeof(OscillateState) },
+  { "Popcorn",           popcorn,          sizeof(PopcornState) },
+  { "Rain",              rain,             0 },
+  { "Rainbow Fireworks", rainbowFireworks, 0 },
+  { "Rainbow Larson",    rainbowLarson,    0 },
+  { "Random Chase",      randomChase,      0 },
+  { "TriFade",           triFade,          0 },
+  { "TwinkleFox",        twinkleFox,       0 },
+  { "VU Meter",          vuMeter,          0 }
+};
+
+#define CUSTOM_EFFECT_COUNT (sizeof(_custom_effects)/sizeof(_custom_effects[0]))
+
+// the matrix effect renders whatever page data it is given, so give it some
+static uint32_t _matrix_pages[2 * 4 * 8];
+
+static void initCustomEffects(void) {
+  for(uint16_t i=0; i < sizeof(_matrix_pages)/sizeof(_matrix_pages[0]); i++) {
+    _matrix_pages[i] = (i & 1) ? RED : BLUE;
+  }
+  configMatrix(2, 4, 8, _matrix_pages);
+}
+
+#endif
@@ -0,0 +1,87 @@
+/*
+  fxrun.cpp - run one effect on the host for a number of frames.
+
+  usage: fxrun <mode> [num_leds] [num_frames] [options] [brightness]
+         fxrun -l
+
+  <mode> is a builtin mode number, or the name of a builtin mode or of one
+  of the effects in src/custom (e.g. "Rainbow Cycle" or "Popcorn").
+  [options] is the segment options byte (e.g. 0x88 for REVERSE | GAMMA).
+  [brightness] is the strip brightness (default 255).
+  -l lists the names of every builtin mode and custom effect.
+
+  Meant to be run under perf or valgrind, e.g.
+    perf record ./build/fxrun "Rainbow Cycle" 10000 5000
+*/
+
+#include <stdio.h>
+#include <chrono>
+
+#include "host.h"
+#include "custom_effects.h"
+
+static int findMode(const char* arg) {
+  char* end;
+  long m = strtol(arg, &end, 0);
+  if(*end == '\0') return (m >= 0 && m < FX_MODE_CUSTOM_0) ? (int)m : -1;
+
+  for(uint8_t i=0; i < FX_MODE_CUSTOM_0; i++) {
+    if(strcmp(arg, (const char*)ws2812fx.getModeName(i)) == 0) return i;
+  }
+  for(uint8_t i=0; i < CUSTOM_EFFECT_COUNT; i++) {
+    if(strcmp(arg, _custom_effects[i].name) == 0) {
+      return ws2812fx.setCustomMode(0, F(_custom_effects[i].name), _custom_effects[i].mode, _custom_effects[i].stateSize);
+    }
+  }
+  return -1;
+}
+
+static void listModes(void) {
+  for(uint8_t i=0; i < FX_MODE_CUSTOM_0; i++) {
+    printf("%s\n", (const char*)ws2812fx.getModeName(i));
+  }
+  for(uint8_t i=0; i < CUSTOM_EFFECT_COUNT; i++) {
+    printf("%s\n", _custom_effects[i].name);
+  }
+}
+
+int main(int argc, char** argv) {
+  if(argc < 2) {
+    fprintf(stderr, "usage: %s <mode> [num_leds] [num_frames] [options] [brightness]\n", argv[0]);
+    return 1;
+  }
+  uint16_t numLeds    = argc > 2 ? atoi(argv[2]) : 300;
+  uint32_t numFrames  = argc > 3 ? atol(argv[3]) : 1000;
+  uint8_t  options    = argc > 4 ? strtol(argv[4], NULL, 0) : NO_OPTIONS;
+  uint8_t  brightness = argc > 5 ? atoi(argv[5]) : 255;
+
+  hostStrip(numLeds);
+  initCustomEffects();
+
+  if(strcmp(argv[1], "-l") == 0) {
+    listModes();
+    return 0;
+  }
+
+  int mode = findMode(argv[1]);
+  if(mode < 0) {
+    fprintf(stderr, "unknown mode: %s\n", argv[1]);
+    return 1;
+  }
+
+  ws2812fx.setBrightness(brightness);
+  ws2812fx.setSegment(0, 0, numLeds - 1, mode, COLORS(RED, GREEN, BLUE), 1000, options);
+  ws2812fx.start();
+
+  std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+  for(uint32_t i=0; i < numFrames; i++) {
+    hostServiceFrame();
+  }
+  std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+  double ns = std::chrono::duration<double, std::nano>(t1 - t0).count();
+
+  printf("%s: %u leds, %u frames, %u shows, %.0f ns/frame, hash %08x\n",
+    (const char*)ws2812fx.getModeName(mode), numLeds, numFrames, ws2812fx.hostShowCount(),
+    ns / numFrames, hostPixelHash());
+  return 0;
+}
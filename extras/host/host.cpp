@@ -0,0 +1,44 @@
+/*
+  host.cpp - shared setup for the host programs.
+*/
+
+#include <new>
+#include "host.h"
+
+static uint8_t* _draw_buffer = NULL;
+static uint8_t* _frame_buffer = NULL;
+
+static uint8_t _boot_draw_buffer[4];
+static uint8_t _boot_frame_buffer[16];
+
+WS2812FX ws2812fx = WS2812FX(1, _boot_frame_buffer, _boot_draw_buffer, 1, WS2812_GRB);
+
+void hostStrip(uint16_t num_leds, uint8_t type) {
+  uint8_t bytesPerPixel = (type < 6) ? 3 : 4;
+
+  delete[] _draw_buffer;
+  delete[] _frame_buffer;
+  _draw_buffer = new uint8_t[num_leds * bytesPerPixel]();
+  _frame_buffer = new uint8_t[num_leds * bytesPerPixel * 4]();
+
+  // WS2812Serial's LED count is fixed at construction, so build a new
+  // instance in place of the global one
+  ws2812fx.~WS2812FX();
+  new (&ws2812fx) WS2812FX(num_leds, _frame_buffer, _draw_buffer, 1, type);
+  ws2812fx.init();
+}
+
+void hostServiceFrame(void) {
+  do {
+    hostClockAdvance(1000);
+  } while(!ws2812fx.service());
+}
+
+uint32_t hostPixelHash(void) {
+  uint8_t* pixels = ws2812fx.getPixels();
+  uint32_t hash = 2166136261UL;
+  for(uint16_t i=0; i < ws2812fx.getNumBytes(); i++) {
+    hash = (hash ^ pixels[i]) * 16777619UL;
+  }
+  return hash;
+}
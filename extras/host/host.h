@@ -0,0 +1,24 @@
+/*
+  host.h - shared setup for the host programs.
+
+  Defines the global ws2812fx instance the host programs drive and lets a
+  host program size it at runtime.
+*/
+
+#ifndef host_h
+#define host_h
+
+#include <WS2812FX.h>
+
+extern WS2812FX ws2812fx;
+
+// (re)create the global ws2812fx for a strip of num_leds pixels
+void hostStrip(uint16_t num_leds, uint8_t type=WS2812_GRB);
+
+// step the virtual clock 1ms at a time until service() renders a frame
+void hostServiceFrame(void);
+
+// FNV-1a hash of the draw buffer, handy for spotting output changes
+uint32_t hostPixelHash(void);
+
+#endif
@@ -0,0 +1,549 @@
+/*
+  sched_test.cpp - checks of the segment scheduling in service() and of
+  the pixel buffers and tables behind it, run by `make check`. Prints a line
+  per failed check and exits non-zero if any failed.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <initializer_list>
+#include <new>
+
+#include "host.h"
+
+static int _failures = 0;
+
+static void expect(bool ok, const char* what) {
+  if(!ok) {
+    printf("FAIL: %s\n", what);
+    _failures++;
+  }
+}
+
+// count heap allocations, to check what's meant to stay off the heap
+static uint32_t _allocations = 0;
+
+void* operator new(size_t size) {
+  _allocations++;
+  void* p = malloc(size ? size : 1);
+  if(p == NULL) throw std::bad_alloc();
+  return p;
+}
+
+void* operator new[](size_t size) {
+  return operator new(size);
+}
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+
+static uint16_t tenMillis(WS2812FX& fx, WS2812FX::Segment* seg, WS2812FX::Segment_runtime* segrt) {
+  fx.setPixelColor(seg->start, random(0x1000000)); // change a pixel, so most frames are shown
+  return 10; // ms
+}
+
+static uint16_t noDelay(WS2812FX& fx, WS2812FX::Segment* seg, WS2812FX::Segment_runtime* segrt) {
+  return 0; // leaves the pixels alone, so nothing is shown
+}
+
+static uint16_t speedDelay(WS2812FX& fx, WS2812FX::Segment* seg, WS2812FX::Segment_runtime* segrt) {
+  fx.setPixelColor(seg->start, random(0x1000000));
+  return seg->speed; // ms
+}
+
+// count the frames rendered by calling service() every step_us for ms milliseconds
+static uint32_t runFor(uint32_t ms, uint32_t step_us=100) {
+  uint32_t frames = 0;
+  uint64_t end = hostClock() + ms * 1000ULL;
+  while(hostClock() < end) {
+    hostClockAdvance(step_us);
+    if(ws2812fx.service()) frames++;
+  }
+  return frames;
+}
+
+// a segment trigger()ed before it's due must not have its deadline pushed out
+static void testTriggerBurst(void) {
+  hostStrip(10);
+  uint8_t mode = ws2812fx.setCustomMode(F("Ten Millis"), tenMillis);
+  ws2812fx.setSegment(0, 0, 9, mode, RED, 1000, NO_OPTIONS);
+  ws2812fx.start();
+
+  uint32_t frames = runFor(1000);
+  expect(frames >= 99 && frames <= 101, "10ms effect renders 100 frames a second");
+
+  uint64_t end = hostClock() + 2000000ULL; // trigger every ms for 2s
+  while(hostClock() < end) {
+    hostClockAdvance(1000);
+    ws2812fx.trigger();
+    ws2812fx.service();
+  }
+  expect((long)(ws2812fx.nextDeadlineMicros() - micros()) <= 10000L, "deadline within one delay after a trigger burst");
+
+  frames = runFor(1000);
+  expect(frames >= 99 && frames <= 101, "10ms effect renders 100 frames a second after a trigger burst");
+}
+
+// earliest next_time of the active segments, as micros() from now
+static unsigned long earliestDeadline(void) {
+  unsigned long now = micros();
+  unsigned long earliest = 0xFFFFFFFF;
+  uint8_t* active = ws2812fx.getActiveSegments();
+  WS2812FX::Segment_runtime* runtimes = ws2812fx.getSegmentRuntimes();
+  for(uint8_t i=0; i < MAX_NUM_ACTIVE_SEGMENTS; i++) {
+    if(active[i] == INACTIVE_SEGMENT) continue;
+    long wait = (long)(runtimes[i].next_time - now);
+    if(wait < 0) wait = 0;
+    if((unsigned long)wait < earliest) earliest = wait;
+  }
+  return earliest;
+}
+
+// nextDeadlineMicros() must match the earliest segment deadline (rounded
+// up to a refresh tick when paced), and service() render nothing before it
+static void testNextDeadline(void) {
+  hostStrip(30);
+  uint8_t mode = ws2812fx.setCustomMode(F("Speed Delay"), speedDelay);
+  ws2812fx.setSegment(0, 0, 9, mode, RED, 7, NO_OPTIONS);
+  ws2812fx.setSegment(1, 10, 19, mode, GREEN, 11, NO_OPTIONS);
+  ws2812fx.setSegment(2, 20, 29, mode, BLUE, 13, NO_OPTIONS);
+  expect(ws2812fx.nextDeadline() == MAX_MILLIS, "no deadline while stopped");
+  ws2812fx.start();
+
+  for(uint16_t refresh : { 0, 60 }) {
+    ws2812fx.setRefreshRate(refresh);
+    unsigned long period = refresh ? 1000000UL / refresh : 1;
+    bool exact = true, early = true, onTime = true, millisRounded = true;
+    for(uint16_t i=0; i < 200; i++) {
+      ws2812fx.service();
+      unsigned long wait = ws2812fx.nextDeadlineMicros() - micros();
+      unsigned long earliest = earliestDeadline();
+      if(wait < earliest || wait - earliest >= period) exact = false;
+      if(ws2812fx.nextDeadline() != millis() + (wait + 999) / 1000) millisRounded = false;
+      if(wait > 1) {
+        hostClockAdvance(wait - 1);
+        if(ws2812fx.service()) early = false;
+        hostClockAdvance(1);
+      } else {
+        hostClockAdvance(wait);
+      }
+      if(!ws2812fx.service()) onTime = false;
+      hostClockAdvance(random(3000));
+    }
+    expect(exact, refresh ? "nextDeadlineMicros() is the earliest deadline's refresh tick" : "nextDeadlineMicros() is the earliest deadline");
+    expect(early, "service() renders nothing before nextDeadlineMicros()");
+    expect(onTime, "service() renders at nextDeadlineMicros()");
+    expect(millisRounded, "nextDeadline() is nextDeadlineMicros() rounded up to a millisecond");
+  }
+  ws2812fx.setRefreshRate(0);
+
+  ws2812fx.trigger();
+  expect(ws2812fx.nextDeadlineMicros() == micros(), "a trigger()ed segment is due now");
+  ws2812fx.service();
+  ws2812fx.pause();
+  expect(ws2812fx.nextDeadline() == MAX_MILLIS, "no deadline while paused");
+}
+
+// with a refresh rate, segments at unrelated speeds are shown together, on
+// ticks spaced exactly one period apart
+static void testRefreshTicks(void) {
+  hostStrip(30);
+  uint8_t mode = ws2812fx.setCustomMode(F("Speed Delay"), speedDelay);
+  for(uint8_t i=0; i < 10; i++) {
+    ws2812fx.setSegment(i, i * 3, i * 3 + 2, mode, RED, 3 + i * 7 % 10, NO_OPTIONS);
+  }
+  ws2812fx.start();
+  ws2812fx.setRefreshRate(50);
+  uint64_t start = hostClock();
+
+  uint32_t shows = ws2812fx.hostShowCount(), ticks = 0;
+  bool onTick = true;
+  uint64_t end = start + 1000000ULL;
+  while(hostClock() < end) {
+    uint64_t now = hostClock();
+    ws2812fx.service();
+    hostClockAdvance(100);
+    if(ws2812fx.hostShowCount() != shows) {
+      if(ws2812fx.hostShowCount() - shows != 1) onTick = false; // one show() per tick
+      if((now - start) % 20000 != 0) onTick = false;
+      shows = ws2812fx.hostShowCount();
+      ticks++;
+    }
+  }
+  expect(onTick, "at 50 Hz, shows happen once per tick, on 20ms ticks");
+  expect(ticks >= 49 && ticks <= 51, "at 50 Hz, ten busy segments are shown 50 times a second");
+  ws2812fx.setRefreshRate(0);
+}
+
+// with async show, service() never waits for the previous frame to be
+// sent: a frame rendered meanwhile is held back, and shown once the port
+// is free
+static void testAsyncShow(void) {
+  hostStrip(600); // 18.3ms per frame on the wire
+  uint8_t mode = ws2812fx.setCustomMode(F("Speed Delay"), speedDelay);
+  ws2812fx.setSegment(0, 0, 599, mode, RED, 10, NO_OPTIONS);
+  ws2812fx.start();
+  ws2812fx.setAsyncShow(true);
+
+  bool neverWaits = true, skipsBusy = true, holdsFrames = true, pended = false;
+  uint64_t end = hostClock() + 1000000ULL;
+  while(hostClock() < end) {
+    hostClockAdvance(100);
+    uint64_t before = hostClock();
+    bool busy = ws2812fx.busy();
+    bool pending = ws2812fx.isShowPending();
+    uint32_t shows = ws2812fx.hostShowCount();
+    uint32_t calls = ws2812fx.getSegmentRuntime(0)->counter_mode_call;
+    ws2812fx.service();
+    if(hostClock() != before) neverWaits = false;
+    if(busy && ws2812fx.hostShowCount() != shows) skipsBusy = false;
+    if(pending && busy && ws2812fx.getSegmentRuntime(0)->counter_mode_call != calls) holdsFrames = false;
+    if(ws2812fx.isShowPending()) pended = true;
+  }
+  expect(neverWaits, "async service() never waits for the serial port");
+  expect(skipsBusy, "async service() doesn't show while the previous frame is being sent");
+  expect(holdsFrames, "async service() renders nothing while a frame is waiting");
+  expect(pended, "async service() holds back frames rendered while busy");
+  expect(ws2812fx.hostShowCount() >= 50, "async show keeps the serial port busy");
+
+  ws2812fx.setAsyncShow(false);
+  uint64_t before = hostClock();
+  for(uint8_t i=0; i < 10; i++) {
+    hostClockAdvance(100);
+    ws2812fx.service();
+  }
+  expect(hostClock() > before + 1000, "sync service() waits for the serial port");
+}
+
+// modes with fixed millisecond delays keep them on TIME_MICROS segments,
+// and a mode returning 0 is held to SPEED_MIN_MICROS
+static void testTimeMicros(void) {
+  hostStrip(10);
+  ws2812fx.setSegment(0, 0, 9, FX_MODE_BREATH, RED, 1000, TIME_MICROS);
+  ws2812fx.start();
+  uint32_t frames = runFor(1000);
+  expect(frames > 20 && frames < 100, "TIME_MICROS breath steps take milliseconds");
+
+  hostStrip(10);
+  uint8_t mode = ws2812fx.setCustomMode(F("No Delay"), noDelay);
+  ws2812fx.setSegment(0, 0, 9, mode, RED, 1000, TIME_MICROS);
+  ws2812fx.start();
+  frames = runFor(100, 10);
+  expect(frames <= 100000 / SPEED_MIN_MICROS, "TIME_MICROS frames are at least SPEED_MIN_MICROS apart");
+}
+
+// with a linear buffer, changes that only affect how show() scales the
+// pixels must still be shown
+static void testLinearBufferShows(void) {
+  static uint8_t linear[10 * 3];
+  hostStrip(10);
+  ws2812fx.setLinearBuffer(linear);
+  ws2812fx.setSegment(0, 0, 9, FX_MODE_STATIC, 0x808080, 10, NO_OPTIONS);
+  ws2812fx.start();
+  runFor(100);
+
+  uint32_t shows = ws2812fx.hostShowCount();
+  ws2812fx.setOptions(0, GAMMA);
+  runFor(100);
+  expect(ws2812fx.hostShowCount() > shows, "turning GAMMA on is shown");
+
+  shows = ws2812fx.hostShowCount();
+  ws2812fx.setSegment(0, 5, 9, FX_MODE_STATIC, 0x808080, 10, GAMMA);
+  runFor(100);
+  expect(ws2812fx.hostShowCount() > shows, "moving a GAMMA segment is shown");
+
+  shows = ws2812fx.hostShowCount();
+  ws2812fx.setDithering(true);
+  runFor(100);
+  expect(ws2812fx.hostShowCount() > shows, "turning dithering on is shown");
+  ws2812fx.setLinearBuffer(NULL);
+}
+
+// below full brightness getPixelColor() can't return the exact color that
+// was set, but setting what it returns must leave the pixel as it was
+static void testPixelRoundTrip(void) {
+  static const uint8_t brightnesses[] = { 1, 10, 64, 128, 200, 254 };
+  hostStrip(40);
+  for(uint8_t b : brightnesses) {
+    ws2812fx.setBrightness(b);
+    bool same = true;
+    for(uint16_t v=0; v < 256; v++) {
+      ws2812fx.setPixelColor(0, v * 0x010101);
+      uint8_t stored = ws2812fx.getPixels()[0];
+      ws2812fx.setPixelColor(0, ws2812fx.getPixelColor(0));
+      if(ws2812fx.getPixels()[0] != stored) same = false;
+    }
+    expect(same, "getPixelColor()/setPixelColor() round trip keeps the pixel");
+
+    // shift a pixel down the strip, like the chase effects do
+    ws2812fx.setPixelColor(0, 0x202020);
+    for(uint16_t i=1; i < 40; i++) ws2812fx.setPixelColor(i, ws2812fx.getPixelColor(i - 1));
+    expect(ws2812fx.getPixels()[39 * 3] == ws2812fx.getPixels()[0], "pixel copied along the strip keeps its color");
+  }
+}
+
+// brightness changes mustn't lose the pixels of a paused strip, and
+// brightness 0 blanks the strip without clearing them
+static void testBrightnessLossless(void) {
+  static uint8_t frame[10 * 12], draw[10 * 3];
+  WS2812FX fx(10, frame, draw, 1, WS2812_GRB);
+  fx.init();
+  fx.setBrightness(255);
+  fx.setSegment(0, 0, 9, FX_MODE_STATIC, 0xFF8040, 1000, NO_OPTIONS);
+  fx.start();
+  fx.service();
+  fx.pause();
+
+  fx.setBrightness(10);
+  fx.setBrightness(255);
+  expect(fx.getPixelColor(5) == 0xFF8040, "paused strip keeps its colors through 255 -> 10 -> 255");
+
+  fx.setBrightness(0);
+  bool black = true;
+  for(uint8_t b : frame) if(b != 0xEF) black = false; // 0xEF encodes two 0 bits
+  expect(black, "brightness 0 blanks the strip");
+  fx.setBrightness(255);
+  expect(fx.getPixelColor(5) == 0xFF8040, "paused strip keeps its colors through 255 -> 0 -> 255");
+  expect(frame[0] != 0xEF, "turning brightness back up from 0 shows the strip");
+}
+
+// counts its frames in its per segment state
+static uint32_t* _frame_counts[2];
+
+static uint16_t countFrames(WS2812FX& fx, WS2812FX::Segment* seg, WS2812FX::Segment_runtime* segrt) {
+  uint32_t* frames = (uint32_t*)fx.getModeState();
+  _frame_counts[seg - fx.getSegments()] = frames;
+  (*frames)++;
+  return 10;
+}
+
+// the r -> g -> b wheel color_wheel() computed before it became a table
+static uint32_t referenceWheel(uint8_t pos) {
+  pos = 255 - pos;
+  if(pos < 85) return ((uint32_t)(255 - pos * 3) << 16) | (pos * 3);
+  if(pos < 170) { pos -= 85; return ((uint32_t)(pos * 3) << 8) | (255 - pos * 3); }
+  pos -= 170;
+  return ((uint32_t)(pos * 3) << 16) | ((uint32_t)(255 - pos * 3) << 8);
+}
+
+// reads every segment's wheel through color_wheel()
+static uint32_t _wheels[3][256];
+
+static uint16_t readWheel(WS2812FX& fx, WS2812FX::Segment* seg, WS2812FX::Segment_runtime* segrt) {
+  for(uint16_t pos=0; pos < 256; pos++) _wheels[seg - fx.getSegments()][pos] = fx.color_wheel(pos);
+  return 1000;
+}
+
+// each segment's color_wheel() follows its own palette or table, and the
+// rest keep the default table
+static void testColorWheels(void) {
+  static const uint32_t sunsetColors[] = { RED, ORANGE, YELLOW, ORANGE };
+  static const WS2812FX::Palette sunset = { 4, NULL, sunsetColors };
+  static const uint8_t  glowStops[]  = { 0, 100, 255 };
+  static const uint32_t glowColors[] = { BLACK, PURPLE, WHITE };
+  static const WS2812FX::Palette glow = { 3, glowStops, glowColors };
+  static uint32_t custom[256];
+  for(uint16_t pos=0; pos < 256; pos++) custom[pos] = pos * 0x010101;
+
+  hostStrip(30);
+  uint8_t mode = ws2812fx.setCustomMode(F("Read Wheel"), readWheel);
+  for(uint8_t i=0; i < 3; i++) ws2812fx.setSegment(i, i * 10, i * 10 + 9, mode, RED, 1000, NO_OPTIONS);
+  ws2812fx.setPalette(1, &sunset);
+  ws2812fx.setColorWheel(2, custom);
+  ws2812fx.start();
+  hostServiceFrame();
+
+  bool matches = true;
+  for(uint16_t pos=0; pos < 256; pos++) {
+    if(_ColorWheelTable.colors[pos] != referenceWheel(pos) || _wheels[0][pos] != referenceWheel(pos)) matches = false;
+  }
+  expect(matches, "the default wheel table matches the r -> g -> b wheel");
+
+  uint32_t expanded[256];
+  WS2812FX::expandPalette(&sunset, expanded);
+  expect(memcmp(_wheels[1], expanded, sizeof(expanded)) == 0, "a palette segment's color_wheel() is its expanded palette");
+  expect(_wheels[1][0] == RED && _wheels[1][64] == ORANGE && _wheels[1][128] == YELLOW && _wheels[1][192] == ORANGE,
+    "an evenly spaced palette puts its colors a quarter wheel apart");
+  expect(WS2812FX::color_blend(ORANGE, RED, 128) == _wheels[1][224], "an evenly spaced palette blends back to its first color");
+  expect(memcmp(_wheels[2], custom, sizeof(custom)) == 0, "a setColorWheel() segment's color_wheel() is its table");
+
+  WS2812FX::expandPalette(&glow, expanded);
+  expect(expanded[0] == BLACK && expanded[100] == PURPLE && expanded[255] == WHITE, "palette stops land on their positions");
+  expect(expanded[50] == WS2812FX::color_blend(BLACK, PURPLE, 128), "palette stops blend in between");
+
+  ws2812fx.setPalette(1, NULL);
+  ws2812fx.setColorWheel(2, NULL);
+  ws2812fx.trigger();
+  hostServiceFrame();
+  expect(memcmp(_wheels[1], _ColorWheelTable.colors, sizeof(expanded)) == 0 &&
+    memcmp(_wheels[2], _ColorWheelTable.colors, sizeof(expanded)) == 0, "clearing a palette or wheel goes back to the default wheel");
+}
+
+// with an arena, custom mode state lives in it and never touches the heap
+static void testModeStateInArena(void) {
+  static uint8_t frame[10 * 12], draw[10 * 3];
+  alignas(void*) static uint8_t arena[WS2812FX::segmentArenaSize(4, 4)];
+  WS2812FX fx(10, frame, draw, 1, WS2812_GRB, arena, 4, 4);
+  fx.init();
+  expect(fx.setCustomMode(F("Too Big"), countFrames, MODE_STATE_SIZE + 1) == 0, "state larger than MODE_STATE_SIZE is refused");
+  uint8_t mode = fx.setCustomMode(F("Count Frames"), countFrames, sizeof(uint32_t));
+  expect(mode != 0, "state up to MODE_STATE_SIZE is accepted");
+
+  uint32_t allocations = _allocations;
+  for(uint8_t n=0; n < 3; n++) {
+    fx.setSegmentArena(arena, 4, 4);
+    fx.setSegment(0, 0, 4, mode, RED, 10, NO_OPTIONS);
+    fx.setSegment(1, 5, 9, mode, BLUE, 10, NO_OPTIONS);
+    fx.start();
+    for(uint8_t i=0; i < 5; i++) {
+      hostClockAdvance(10000);
+      fx.service();
+    }
+  }
+  expect(_allocations == allocations, "reconfiguring an arena with stateful modes doesn't touch the heap");
+
+  bool inArena = true;
+  for(uint32_t* state : _frame_counts) {
+    if((uint8_t*)state < arena || (uint8_t*)(state + 1) > arena + sizeof(arena)) inArena = false;
+  }
+  expect(inArena, "mode state is placed in the arena");
+  expect(_frame_counts[0] != _frame_counts[1], "each segment has its own mode state");
+  expect(*_frame_counts[0] == 5 && *_frame_counts[1] == 5, "mode state is zeroed when the arena is reconfigured");
+}
+
+// records which mode it was run as
+static uint8_t _ran_mode = 0;
+
+static uint16_t recordMode(WS2812FX& fx, WS2812FX::Segment* seg, WS2812FX::Segment_runtime* segrt) {
+  _ran_mode = seg->mode;
+  return 10;
+}
+
+// custom modes register up to MAX_CUSTOM_MODES, the last one taking mode
+// 254, and are refused past that
+static void testCustomModeLimit(void) {
+  static char names[MAX_CUSTOM_MODES][8];
+  hostStrip(10);
+
+  bool numbered = true;
+  for(uint16_t i=0; i < MAX_CUSTOM_MODES; i++) {
+    snprintf(names[i], sizeof(names[i]), "M%u", i);
+    if(ws2812fx.setCustomMode(F(names[i]), recordMode) != FX_MODE_CUSTOM_0 + i) numbered = false;
+  }
+  expect(numbered, "custom modes are numbered from FX_MODE_CUSTOM_0 in registration order");
+  expect(FX_MODE_CUSTOM_0 + MAX_CUSTOM_MODES - 1 == 254, "the last custom mode is 254");
+  expect(ws2812fx.getModeCount() == 255, "getModeCount() counts every custom mode");
+  expect(strcmp((const char*)ws2812fx.getModeName(254), names[MAX_CUSTOM_MODES - 1]) == 0, "the last custom mode keeps its name");
+
+  uint32_t allocations = _allocations;
+  expect(ws2812fx.setCustomMode(F("One Too Many"), recordMode) == 0, "registering past MAX_CUSTOM_MODES returns 0");
+  expect(ws2812fx.setCustomMode(MAX_CUSTOM_MODES, F("One Too Many"), recordMode) == 0, "an index past MAX_CUSTOM_MODES returns 0");
+  expect(ws2812fx.setCustomMode(255, F("One Too Many"), recordMode) == 0, "index 255 returns 0");
+  expect(_allocations == allocations, "refused modes don't allocate");
+  expect(ws2812fx.getModeCount() == 255, "refused modes aren't counted");
+  expect(strcmp((const char*)ws2812fx.getModeName(254), names[MAX_CUSTOM_MODES - 1]) == 0, "refused modes don't replace the last one");
+  expect(ws2812fx.setCustomMode(MAX_CUSTOM_MODES - 1, F("Replaced"), recordMode) == 254, "the last slot can be replaced");
+
+  bool runs = true;
+  for(uint16_t mode=FX_MODE_CUSTOM_0; mode <= 254; mode += 33) {
+    ws2812fx.setSegment(0, 0, 9, mode, RED, 1000, NO_OPTIONS);
+    ws2812fx.start();
+    _ran_mode = 0;
+    hostServiceFrame();
+    if(_ran_mode != mode) runs = false;
+  }
+  ws2812fx.setSegment(0, 0, 9, 254, RED, 1000, NO_OPTIONS);
+  _ran_mode = 0;
+  hostServiceFrame();
+  expect(runs && _ran_mode == 254, "each custom mode runs its own registration");
+
+  hostStrip(10);
+  expect(ws2812fx.setCustomMode(10, F("Sparse"), recordMode) == FX_MODE_CUSTOM_0 + 10, "a mode can be registered past empty slots");
+  expect(ws2812fx.getModeCount() == FX_MODE_CUSTOM_0 + 11, "empty slots below it are counted");
+  expect(strcmp((const char*)ws2812fx.getModeName(FX_MODE_CUSTOM_0 + 5), "Custom") == 0, "an empty slot is named Custom");
+}
+
+static bool inside(const void* p, const uint8_t* block, size_t size) {
+  return (const uint8_t*)p >= block && (const uint8_t*)p < block + size;
+}
+
+// the segment tables go in the caller's arena, aligned, and stay within
+// segmentArenaSize() bytes of it however it's reconfigured; without an
+// arena they're one heap block, freed on reconfigure and teardown (run
+// `make check-asan` to catch stray writes, leaks and double frees)
+static void testSegmentArena(void) {
+  static uint8_t frame[40 * 12], draw[40 * 3];
+  const size_t size = WS2812FX::segmentArenaSize(16, 16);
+  static uint8_t block[WS2812FX::segmentArenaSize(16, 16) + 2];
+  uint8_t* arena = block + 1; // deliberately unaligned
+  memset(block, 0xA5, sizeof(block));
+
+  uint32_t allocations = _allocations;
+  {
+    WS2812FX fx(40, frame, draw, 1, WS2812_GRB, arena, 2, 2);
+    fx.init();
+    expect(_allocations == allocations, "constructing with an arena doesn't allocate");
+
+    static const uint8_t layouts[][2] = { { 2, 2 }, { 16, 16 }, { 16, 1 }, { 1, 16 }, { 8, 4 } };
+    bool placed = true, aligned = true, reset = true, renders = true;
+    for(const uint8_t* layout : layouts) {
+      uint8_t segs = layout[0], active = layout[1];
+      fx.setSegmentArena(arena, segs, active);
+      size_t used = WS2812FX::segmentArenaSize(segs, active);
+      if(!inside(fx.getSegments(), arena, used) || !inside(fx.getSegments() + segs - 1, arena, used) ||
+        !inside(fx.getSegmentRuntimes() + active - 1, arena, used) ||
+        !inside(fx.getActiveSegments() + active - 1, arena, used)) placed = false;
+      if((uintptr_t)fx.getSegments() % alignof(WS2812FX::Segment) != 0 ||
+        (uintptr_t)fx.getSegmentRuntimes() % alignof(WS2812FX::Segment_runtime) != 0) aligned = false;
+      if(fx.getNumSegments() != 1 || fx.getSegment(0)->start != 0 || fx.getSegment(0)->stop != 39) reset = false;
+
+      // fill every segment and active slot, and run them
+      for(uint8_t i=0; i < segs; i++) {
+        fx.setSegment(i, i * 40 / segs, (i + 1) * 40 / segs - 1, FX_MODE_RAINBOW_CYCLE, RED, 10, NO_OPTIONS);
+      }
+      fx.start();
+      uint32_t shows = fx.hostShowCount();
+      for(uint8_t i=0; i < 20; i++) {
+        hostClockAdvance(10000);
+        fx.service();
+      }
+      if(fx.hostShowCount() == shows) renders = false;
+    }
+    expect(placed, "segment tables are placed in the arena");
+    expect(aligned, "segment tables are aligned in an unaligned arena");
+    expect(reset, "setSegmentArena() resets the segments to one full strip segment");
+    expect(renders, "segments run after setSegmentArena()");
+    expect(block[0] == 0xA5 && block[1 + size] == 0xA5, "nothing is written outside the arena");
+    expect(_allocations == allocations, "reconfiguring an arena doesn't allocate");
+
+    fx.setSegmentArena(NULL, 4, 4);
+    expect(_allocations == allocations + 1, "without an arena the tables are one heap block");
+    expect(!inside(fx.getSegments(), block, sizeof(block)), "without an arena the tables move out of it");
+
+    WS2812FX moved(static_cast<WS2812FX&&>(fx)); // the heap block must only be freed once, by moved
+    expect(moved.getNumSegments() == 1 && moved.getSegment(0)->stop == 39, "a move takes over the tables");
+    moved.setSegmentArena(arena, 4, 4); // frees the heap block
+  }
+  expect(block[0] == 0xA5 && block[1 + size] == 0xA5, "nothing is written outside the arena on teardown");
+}
+
+int main(void) {
+  testTriggerBurst();
+  testNextDeadline();
+  testRefreshTicks();
+  testAsyncShow();
+  testTimeMicros();
+  testLinearBufferShows();
+  testPixelRoundTrip();
+  testBrightnessLossless();
+  testColorWheels();
+  testModeStateInArena();
+  testSegmentArena();
+  testCustomModeLimit();
+
+  printf("sched_test: %s\n", _failures == 0 ? "ok" : "FAILED");
+  return _failures == 0 ? 0 : 1;
+}
@@ -55,53 +55,207 @@
 
 #include "WS2812FX.h"
 
+// take over fx's tables, leaving it nothing for its destructor to free
+WS2812FX::WS2812FX(WS2812FX&& fx) : WS2812FX((const WS2812FX&)fx) {
+  fx._segment_block = NULL;
+  fx._palette_wheels = NULL;
+  fx._custom_modes = NULL;
+  fx._identity_lut = NULL;
+  fx._gamma16 = NULL;
+}
+
+WS2812FX::~WS2812FX(void) {
+  freePaletteWheels();
+  delete[] _custom_modes;
+  delete[] _segment_block;
+  delete[] _identity_lut;
+  delete[] _gamma16;
+}
+
 void WS2812FX::init() {
   resetSegmentRuntimes();
   WS2812Serial::begin();
 }
 
-// void WS2812FX::timer() {
-//     for (int j=0; j < 1000; j++) {
-//       uint16_t delay = (this->*_modes[_seg->mode])();
-//     }
-// }
-
 bool WS2812FX::service() {
   bool doShow = false;
   if(_running || _triggered) {
-    unsigned long now = millis(); // Be aware, millis() rolls over every 49 days
-    for(uint8_t i=0; i < _active_segments_len; i++) {
-      if(_active_segments[i] != INACTIVE_SEGMENT) {
-        _seg     = &_segments[_active_segments[i]];
-        _seg_len = (uint16_t)(_seg->stop - _seg->start + 1);
-        _seg_rt  = &_segment_runtimes[i];
-        CLR_FRAME_CYCLE;
-        if(now > _seg_rt->next_time || _triggered) {
-          SET_FRAME;
-          doShow = true;
-          uint16_t delay = (this->*_modes[_seg->mode])();
-          _seg_rt->next_time = now + max(delay, SPEED_MIN);
-          _seg_rt->counter_mode_call++;
+    unsigned long now = micros(); // rolls over every 71 minutes, so only compare differences
+
+    // the FRAME/CYCLE flags only report on the most recent service() call
+    for(uint8_t i=0; i < _frame_segments_len; i++) {
+      _segment_runtimes[_frame_segments[i]].aux_param2 &= ~(FRAME | CYCLE);
+    }
+    _frame_segments_len = 0;
+
+    // with async show, a frame that was rendered while the previous one was
+    // still being sent waits here, rather than blocking in show(). No new
+    // frames are rendered until it's out, due segments just stay due.
+    if(_show_pending) {
+      if(customShow == NULL && WS2812Serial::busy()) return false;
+      show();
+      _shown_hash_valid = true;
+      _show_pending = false;
+    }
+
+    // with a refresh rate set, segments only render on refresh ticks, so
+    // there's at most one show() per tick however many segments are due
+    bool tick = true;
+    if(_refresh_period != 0 && !_triggered) {
+      tick = (unsigned long)(_next_refresh - now - 1) >= _refresh_period;
+      if(tick) {
+        _next_refresh += _refresh_period;
+        if((long)(now - _next_refresh) >= 0) _next_refresh = now + _refresh_period;
+      }
+    }
+
+    // take the segments that are due off the deadline heap, instead of
+    // checking every active segment
+    if(_deadlines_dirty) buildDeadlines();
+    while(tick && _deadlines_len > 0 && ((long)(now - _deadlines[0].next_time) >= 0 || _triggered)) {
+      _frame_segments[_frame_segments_len++] = _deadlines[0].slot;
+      _deadlines[0] = _deadlines[--_deadlines_len];
+      siftDeadline(0);
+    }
+
+    // render them in runtime slot order (insertion sort, the list is short)
+    for(uint8_t i=1; i < _frame_segments_len; i++) {
+      uint8_t slot = _frame_segments[i];
+      uint8_t j = i;
+      for(; j > 0 && _frame_segments[j - 1] > slot; j--) {
+        _frame_segments[j] = _frame_segments[j - 1];
+      }
+      _frame_segments[j] = slot;
+    }
+
+    for(uint8_t i=0; i < _frame_segments_len; i++) {
+      uint8_t slot = _frame_segments[i];
+      _seg     = &_segments[_active_segments[slot]];
+      _seg_len = (uint16_t)(_seg->stop - _seg->start + 1);
+      _seg_rt  = &_segment_runtimes[slot];
+      bool due = (long)(now - _seg_rt->next_time) >= 0; // not just triggered early
+      prepareModeState(slot);
+      SET_FRAME;
+      doShow = true;
+      uint16_t delay = max(runMode(), IS_TIME_MICROS ? SPEED_MIN_MICROS : SPEED_MIN);
+      unsigned long delay_us = IS_TIME_MICROS ? delay : delay * 1000UL;
+
+      // schedule from the previous deadline, so a late service() call doesn't
+      // slow the animation down, unless we've fallen a whole frame behind.
+      // A segment trigger() rendered early starts a fresh delay from now, so
+      // repeated triggers don't push its deadline further and further out.
+      if(due) _seg_rt->next_time += delay_us;
+      if(!due || (long)(now - _seg_rt->next_time) >= 0) _seg_rt->next_time = now + delay_us;
+      _seg_rt->counter_mode_call++;
+
+      // put the segment back on the heap with its new deadline
+      if(!_deadlines_dirty) {
+        uint8_t j = _deadlines_len++;
+        while(j > 0 && (long)(_deadlines[(j - 1) / 2].next_time - _seg_rt->next_time) > 0) {
+          _deadlines[j] = _deadlines[(j - 1) / 2];
+          j = (j - 1) / 2;
         }
+        _deadlines[j].next_time = _seg_rt->next_time;
+        _deadlines[j].slot = slot;
       }
     }
-    if(doShow) {
-      //delay(1); // for ESP32 (see https://forums.adafruit.com/viewtopic.php?f=47&t=117327)
-      show();
+
+    // dithering needs every refresh tick shown, even if nothing was rendered
+    bool redither = _dithering && _linear_buffer != NULL && _refresh_period != 0 && tick;
+
+    if(doShow || redither) {
+      // skip show() if the effects didn't change any pixels (e.g. static or paused effects)
+      uint32_t hash = pixelHash();
+      if(redither || !_shown_hash_valid || hash != _shown_hash) {
+        _shown_hash = hash;
+        if(_async_show && customShow == NULL && WS2812Serial::busy()) {
+          _show_pending = true; // the next service() call will show it
+        } else {
+          //delay(1); // for ESP32 (see https://forums.adafruit.com/viewtopic.php?f=47&t=117327)
+          show();
+          _shown_hash_valid = true;
+        }
+      }
     }
     _triggered = false;
   }
   return doShow;
 }
 
+/*
+ * Returns the millis() time at which service() will next have a frame to
+ * render, so a sketch can sleep until then instead of polling.
+ */
+unsigned long WS2812FX::nextDeadline(void) {
+  unsigned long now = micros();
+  unsigned long next = nextDeadlineMicros();
+  if(next == MAX_MILLIS) return MAX_MILLIS;
+  if((long)(next - now) <= 0) return millis();
+  return millis() + (next - now + 999) / 1000;
+}
+
+/*
+ * Same as nextDeadline(), but returns a micros() time, for segments that
+ * use the TIME_MICROS option.
+ */
+unsigned long WS2812FX::nextDeadlineMicros(void) {
+  if(_triggered || _show_pending) return micros();
+  if(!_running) return MAX_MILLIS;
+  if(_deadlines_dirty) buildDeadlines();
+  if(_deadlines_len == 0) return MAX_MILLIS;
+
+  unsigned long next = _deadlines[0].next_time;
+  if(_refresh_period != 0 && (unsigned long)(_next_refresh - micros() - 1) < _refresh_period) {
+    // round up to the refresh tick the segment will render on
+    long wait = (long)(next - _next_refresh);
+    if(wait <= 0) return _next_refresh;
+    return _next_refresh + (wait + _refresh_period - 1) / _refresh_period * _refresh_period;
+  }
+  return next;
+}
+
+// rebuild the deadline heap from the active segments
+void WS2812FX::buildDeadlines(void) {
+  unsigned long now = micros();
+  _deadlines_len = 0;
+  for(uint8_t i=0; i < _active_segments_len; i++) {
+    if(_active_segments[i] != INACTIVE_SEGMENT) {
+      // a deadline more than one max delay (65535ms) away from micros() was
+      // reset (zeroed) or went stale while paused, make it due now so the
+      // wrap-safe comparisons below hold
+      unsigned long* next_time = &_segment_runtimes[i].next_time;
+      if(*next_time - now + SPEED_MAX * 1000UL > 2 * SPEED_MAX * 1000UL) *next_time = now;
+      _deadlines[_deadlines_len].next_time = *next_time;
+      _deadlines[_deadlines_len++].slot = i;
+    }
+  }
+  for(int16_t i = _deadlines_len / 2 - 1; i >= 0; i--) {
+    siftDeadline(i);
+  }
+  _deadlines_dirty = false;
+}
+
+// move the heap entry at index i down to its place
+void WS2812FX::siftDeadline(uint8_t i) {
+  deadline d = _deadlines[i];
+  while(true) {
+    uint16_t child = 2 * i + 1;
+    if(child >= _deadlines_len) break;
+    if(child + 1 < _deadlines_len && (long)(_deadlines[child + 1].next_time - _deadlines[child].next_time) < 0) {
+      child++;
+    }
+    if((long)(d.next_time - _deadlines[child].next_time) <= 0) break;
+    _deadlines[i] = _deadlines[child];
+    i = child;
+  }
+  _deadlines[i] = d;
+}
+
 // overload setPixelColor() functions so we can use gamma correction
 // (see https://learn.adafruit.com/led-tricks-gamma-correction/the-issue)
+// and apply the brightness setting
 void WS2812FX::setPixelColor(uint16_t n, uint32_t c) {
-  uint8_t w = (c >> 24) & 0xFF;
-  uint8_t r = (c >> 16) & 0xFF;
-  uint8_t g = (c >>  8) & 0xFF;
-  uint8_t b =  c        & 0xFF;
-  setPixelColor(n, r, g, b, w);
+  fillSpan(n, 1, c);
 }
 
 void WS2812FX::setPixelColor(uint16_t n, uint8_t r, uint8_t g, uint8_t b) {
@@ -109,11 +263,7 @@ void WS2812FX::setPixelColor(uint16_t n, uint8_t r, uint8_t g, uint8_t b) {
 }
 
 void WS2812FX::setPixelColor(uint16_t n, uint8_t r, uint8_t g, uint8_t b, uint8_t w) {
-  if(IS_GAMMA) {
-    WS2812Serial::setPixelColor(n, gamma8(r), gamma8(g), gamma8(b), gamma8(w));
-  } else {
-    WS2812Serial::setPixelColor(n, r, g, b, w);
-  }
+  fillSpan(n, 1, ((uint32_t)w << 24) | ((uint32_t)r << 16) | ((uint32_t)g << 8) | b);
 }
 
 void WS2812FX::copyPixels(uint16_t dest, uint16_t src, uint16_t count) {
@@ -134,9 +284,118 @@ void WS2812FX::setPixels(uint16_t num_leds, uint8_t* ptr) {
 
 // overload show() functions so we can use custom show()
 void WS2812FX::show(void) {
+  _shown_hash_valid = false; // pixels may have changed outside of service()
+  if(_linear_buffer != NULL) applyLinearBuffer();
   customShow == NULL ? WS2812Serial::show() : customShow();
 }
 
+/*
+ * Use a separate buffer (the same size as the draw buffer) for the effects
+ * to draw into. Colors are stored in it at full precision, without gamma
+ * correction or brightness scaling, and show() applies both in one pass
+ * as it copies them to the draw buffer. Pass NULL to draw straight into the
+ * draw buffer again.
+ */
+void WS2812FX::setLinearBuffer(void *lb) {
+  if(lb != NULL && _identity_lut == NULL) {
+    _identity_lut = new uint8_t[256];
+    for(uint16_t i=0; i < 256; i++) _identity_lut[i] = i;
+  }
+  _linear_buffer = (uint8_t *) lb;
+  if(_linear_buffer != NULL) memset(_linear_buffer, 0, getNumBytes());
+  _shown_hash_valid = false;
+}
+
+// copy the linear buffer to the draw buffer, through the brightness table,
+// or the gamma and brightness table for GAMMA segments
+void WS2812FX::applyLinearBuffer(void) {
+  if(_dithering) {
+    // bit reversing the frame count spreads each byte's dither thresholds
+    // evenly over any run of 2, 4, 8... frames
+    uint8_t f = _dither_frame++;
+    f = (f & 0xF0) >> 4 | (f & 0x0F) << 4;
+    f = (f & 0xCC) >> 2 | (f & 0x33) << 2;
+    _dither_threshold = (f & 0xAA) >> 1 | (f & 0x55) << 1;
+  }
+
+  applyLinearRange(0, getNumBytes(), false);
+
+  for(uint8_t i=0; i < _active_segments_len; i++) {
+    if(_active_segments[i] == INACTIVE_SEGMENT) continue;
+    segment* seg = &_segments[_active_segments[i]];
+    if((seg->options & GAMMA) != GAMMA || seg->start >= numPixels()) continue;
+    applyLinearRange(seg->start * bytesPerPixel, min(seg->stop + 1, numPixels()) * bytesPerPixel, true);
+  }
+}
+
+void WS2812FX::applyLinearRange(uint16_t first, uint16_t last, bool gamma) {
+  if(_dithering) {
+    // scale at 16 bit precision, then round up or down by comparing the
+    // fraction to this frame's threshold (offset per byte, so neighbouring
+    // pixels don't all step on the same frame)
+    uint16_t mult = _brightness + 1;
+    for(uint16_t i = first; i < last; i++) {
+      uint16_t v = gamma ? _gamma16[_linear_buffer[i]] : _linear_buffer[i] << 8;
+      uint8_t threshold = _dither_threshold + i * 0x9D;
+      drawBuffer[i] = (uint16_t)((((uint32_t)v * mult) >> 8) + threshold) >> 8;
+    }
+  } else {
+    const uint8_t *lut = gamma ? _gamma_bri_lut : _bri_lut;
+    for(uint16_t i = first; i < last; i++) {
+      drawBuffer[i] = lut[_linear_buffer[i]];
+    }
+  }
+}
+
+/*
+ * With a linear buffer, scale the pixels to the brightness setting (and gamma
+ * correct them) at 16 bit precision, and dither the part that doesn't fit in
+ * the 8 bit output over successive frames. Keeps fades smooth at low
+ * brightness, as long as frames are shown often enough (see setRefreshRate()).
+ */
+void WS2812FX::setDithering(bool b) {
+  if(b && _gamma16 == NULL) {
+    // gamma 2.6 like gamma8(), in 8.8 fixed point
+    _gamma16 = new uint16_t[256];
+    for(uint16_t i=0; i < 256; i++) {
+      _gamma16[i] = (uint16_t)(powf(i / 255.0f, 2.6f) * 255.0f * 256.0f + 0.5f);
+    }
+  }
+  _dithering = b;
+}
+
+bool WS2812FX::isDithering(void) {
+  return _dithering;
+}
+
+// cheap hash of the pixels effects draw into, 32 bits at a time
+uint32_t WS2812FX::pixelHash(void) {
+  uint8_t *pixels = getPixels();
+  uint16_t numBytes = getNumBytes();
+  uint32_t hash = 2166136261UL;
+  uint16_t i = 0;
+  for(; i + 4 <= numBytes; i += 4) {
+    uint32_t word;
+    memcpy(&word, pixels + i, sizeof(word));
+    hash = (hash ^ word) * 16777619UL;
+  }
+  for(; i < numBytes; i++) {
+    hash = (hash ^ pixels[i]) * 16777619UL;
+  }
+  if(_linear_buffer != NULL) {
+    // the linear buffer is unscaled, so also hash what decides how show()
+    // scales it: dithering and the GAMMA ranges of the active segments
+    hash = (hash ^ _dithering) * 16777619UL;
+    for(uint8_t i=0; i < _active_segments_len; i++) {
+      if(_active_segments[i] == INACTIVE_SEGMENT) continue;
+      segment* seg = &_segments[_active_segments[i]];
+      if((seg->options & GAMMA) != GAMMA) continue;
+      hash = (hash ^ (((uint32_t)seg->stop << 16) | seg->start)) * 16777619UL;
+    }
+  }
+  return hash;
+}
+
 void WS2812FX::start() {
   resetSegmentRuntimes();
   _running = true;
@@ -153,6 +412,7 @@ void WS2812FX::pause() {
 
 void WS2812FX::resume() {
   _running = true;
+  _deadlines_dirty = true; // catch deadlines that went stale while paused
 }
 
 void WS2812FX::trigger() {
@@ -165,7 +425,7 @@ void WS2812FX::setMode(uint8_t m) {
 
 void WS2812FX::setMode(uint8_t seg, uint8_t m) {
   resetSegmentRuntime(seg);
-  _segments[seg].mode = constrain(m, 0, MODE_COUNT - 1);
+  _segments[seg].mode = min(m, FX_MODE_CUSTOM_0 + MAX_CUSTOM_MODES - 1);
 }
 
 void WS2812FX::setOptions(uint8_t seg, uint8_t o) {
@@ -212,10 +472,129 @@ void WS2812FX::setColors(uint8_t seg, uint32_t* c) {
   }
 }
 
+/*
+ * Swap in a different table of 256 colors for color_wheel() to use in one
+ * segment, e.g. a gamma corrected or themed wheel. The table isn't copied,
+ * so it has to stay around (typically a const array in flash). NULL goes
+ * back to the default wheel.
+ */
+void WS2812FX::setColorWheel(uint8_t seg, const uint32_t* wheel) {
+  if(seg < _segments_len) _segments[seg].wheel = wheel;
+}
+
+/*
+ * Color a segment's rainbow and random color modes from a palette. The
+ * palette is expanded into a 256 color wheel for the segment (1K of RAM,
+ * allocated the first time), so lookups cost no more than the default wheel.
+ * NULL goes back to the default wheel.
+ */
+void WS2812FX::setPalette(uint8_t seg, const Palette* p) {
+  if(seg >= _segments_len) return;
+  if(p == NULL) {
+    _segments[seg].wheel = NULL;
+    return;
+  }
+
+  if(_palette_wheels == NULL) _palette_wheels = new uint32_t*[_segments_len]();
+  if(_palette_wheels[seg] == NULL) _palette_wheels[seg] = new uint32_t[256];
+  expandPalette(p, _palette_wheels[seg]);
+  _segments[seg].wheel = _palette_wheels[seg];
+}
+
+/*
+ * Interpolate a palette into a wheel of 256 colors. Evenly spaced palettes
+ * wrap around (the last color blends back into the first), palettes with
+ * stops hold the first and last colors before and after their end stops.
+ */
+void WS2812FX::expandPalette(const Palette* p, uint32_t* wheel) {
+  uint8_t n = p->num_stops;
+  for(uint16_t pos=0; pos < 256; pos++) {
+    wheel[pos] = n > 0 ? p->colors[0] : 0;
+  }
+
+  for(uint8_t k=0; k < n; k++) {
+    uint16_t start = p->stops ? p->stops[k] : (k * 256) / n;
+    uint16_t end;
+    uint32_t next;
+    if(k + 1 < n) {
+      end = p->stops ? p->stops[k + 1] : ((k + 1) * 256) / n;
+      next = p->colors[k + 1];
+    } else {
+      end = 256;
+      next = p->stops ? p->colors[k] : p->colors[0];
+    }
+
+    for(uint16_t pos = start; pos < end; pos++) {
+      wheel[pos] = color_blend(p->colors[k], next, ((pos - start) * 256) / (end - start));
+    }
+  }
+}
+
+/*
+ * Brightness is applied as pixels are written, so pixels already drawn keep
+ * the old brightness until the effects redraw them (rescaling them here
+ * would lose precision on every change). Brightness 0 blanks the strip at
+ * show() instead, leaving the pixels as they were for when it's turned back
+ * up. With a linear buffer, show() applies the brightness to every pixel,
+ * so a change is shown straight away.
+ */
 void WS2812FX::setBrightness(uint8_t b) {
   b = constrain(b, BRIGHTNESS_MIN, BRIGHTNESS_MAX);
-  WS2812Serial::setBrightness(b);
-  show();
+  if(b == _brightness) return;
+
+  bool blanking = (b == 0) != (_brightness == 0);
+  _brightness = b;
+  updateLuts();
+  WS2812Serial::setBrightness(b == 0 ? 0 : BRIGHTNESS_MAX);
+  if(blanking || _linear_buffer != NULL) show();
+}
+
+uint8_t WS2812FX::getBrightness(void) {
+  return _brightness;
+}
+
+/*
+ * Limit service() to one show() per refresh tick, at a fixed rate of hz
+ * ticks per second. Due segments wait for the next tick and are rendered
+ * together. 0 turns the limit off (show whenever a segment is due).
+ */
+void WS2812FX::setRefreshRate(uint16_t hz) {
+  _refresh_rate = hz;
+  _refresh_period = hz ? 1000000UL / hz : 0;
+  _next_refresh = micros();
+}
+
+uint16_t WS2812FX::getRefreshRate(void) {
+  return _refresh_rate;
+}
+
+/*
+ * With async show enabled, service() never waits for the previous frame to
+ * finish sending. A frame rendered while the serial port is busy is held
+ * back (isShowPending() returns true) and shown by a later service() call,
+ * and rendering pauses until it has been. The next frame is then rendered
+ * while this one is being sent.
+ */
+void WS2812FX::setAsyncShow(bool b) {
+  _async_show = b;
+  if(!b && _show_pending) {
+    show();
+    _shown_hash_valid = true;
+    _show_pending = false;
+  }
+}
+
+bool WS2812FX::isShowPending(void) {
+  return _show_pending;
+}
+
+// rebuild the brightness lookup tables, scaling the same way as WS2812Serial
+void WS2812FX::updateLuts(void) {
+  uint16_t mult = _brightness + 1;
+  for(uint16_t i=0; i < 256; i++) {
+    _bri_lut[i]       = (i * mult) >> 8;
+    _gamma_bri_lut[i] = (gamma8(i) * mult) >> 8;
+  }
 }
 
 void WS2812FX::increaseBrightness(uint8_t s) {
@@ -270,9 +649,9 @@ bool WS2812FX::isFrame(void) {
 }
 
 bool WS2812FX::isFrame(uint8_t seg) {
-  uint8_t* ptr = (uint8_t*)memchr(_active_segments, seg, _active_segments_len);
-  if(ptr == NULL) return false; // segment not active
-  return (_segment_runtimes[ptr - _active_segments].aux_param2 & FRAME);
+  uint8_t slot = segmentSlot(seg);
+  if(slot == INACTIVE_SEGMENT) return false; // segment not active
+  return (_segment_runtimes[slot].aux_param2 & FRAME);
 }
 
 bool WS2812FX::isCycle() {
@@ -280,9 +659,9 @@ bool WS2812FX::isCycle() {
 }
 
 bool WS2812FX::isCycle(uint8_t seg) {
-  uint8_t* ptr = (uint8_t*)memchr(_active_segments, seg, _active_segments_len);
-  if(ptr == NULL) return false; // segment not active
-  return (_segment_runtimes[ptr - _active_segments].aux_param2 & CYCLE);
+  uint8_t slot = segmentSlot(seg);
+  if(slot == INACTIVE_SEGMENT) return false; // segment not active
+  return (_segment_runtimes[slot].aux_param2 & CYCLE);
 }
 
 void WS2812FX::setCycle() {
@@ -321,8 +700,9 @@ uint8_t WS2812FX::getNumBytesPerPixel(void) {
   return bytesPerPixel; // 3=RGB, 4=RGBW
 }
 
+// number of builtin modes plus the custom mode slots registered so far
 uint8_t WS2812FX::getModeCount(void) {
-  return MODE_COUNT;
+  return FX_MODE_CUSTOM_0 + _custom_modes_len;
 }
 
 uint8_t WS2812FX::getNumSegments(void) {
@@ -345,6 +725,10 @@ uint32_t* WS2812FX::getColors(uint8_t seg) {
   return _segments[seg].colors;
 }
 
+const uint32_t* WS2812FX::getColorWheel(uint8_t seg) {
+  return _segments[seg].wheel;
+}
+
 WS2812FX::Segment* WS2812FX::getSegment(void) {
   return _seg;
 }
@@ -362,15 +746,41 @@ WS2812FX::Segment_runtime* WS2812FX::getSegmentRuntime(void) {
 }
 
 WS2812FX::Segment_runtime* WS2812FX::getSegmentRuntime(uint8_t seg) {
-  uint8_t* ptr = (uint8_t*)memchr(_active_segments, seg, _active_segments_len);
-  if(ptr == NULL) return NULL; // segment not active
-  return &_segment_runtimes[ptr - _active_segments];
+  uint8_t slot = segmentSlot(seg);
+  if(slot == INACTIVE_SEGMENT) return NULL; // segment not active
+  return &_segment_runtimes[slot];
 }
 
 WS2812FX::Segment_runtime* WS2812FX::getSegmentRuntimes(void) {
   return _segment_runtimes;
 }
 
+/*
+ * Returns the state a custom mode keeps for the segment it's rendering, of
+ * the size it was registered with (see setCustomMode()), or NULL if it was
+ * registered without one. Each segment running the mode gets its own, zeroed
+ * when the segment starts the mode, so a mode that keeps its state here
+ * rather than in statics can run on several segments at once.
+ */
+void* WS2812FX::getModeState(void) {
+  return _mode_state;
+}
+
+// point _mode_state at the current segment's custom mode state, zeroing
+// it if the segment has just started its mode
+void WS2812FX::prepareModeState(uint8_t slot) {
+  mode_state* ms = &_mode_states[slot];
+  uint8_t* data = _mode_state_data + slot * MODE_STATE_SIZE;
+  const custom_mode* cm = customMode(_seg->mode);
+  uint16_t size = cm != NULL ? cm->state_size : 0;
+  if(_seg_rt->counter_mode_call == 0 || ms->mode != _seg->mode || ms->size != size) {
+    memset(data, 0, size);
+    ms->size = size;
+    ms->mode = _seg->mode;
+  }
+  _mode_state = size != 0 ? data : NULL;
+}
+
 uint8_t* WS2812FX::getActiveSegments(void) {
   return _active_segments;
 }
@@ -378,6 +788,12 @@ uint8_t* WS2812FX::getActiveSegments(void) {
 const __FlashStringHelper* WS2812FX::getModeName(uint8_t m) {
   if(m < MODE_COUNT) {
     return _names[m];
+  }
+  const custom_mode* cm = customMode(m);
+  if(cm != NULL && cm->name != NULL) {
+    return cm->name;
+  } else if(cm != NULL) {
+    return F("Custom");
   } else {
     return F("");
   }
@@ -462,11 +878,12 @@ void WS2812FX::setIdleSegment(uint8_t n, uint16_t start, uint16_t stop, uint8_t
 }
 
 void WS2812FX::addActiveSegment(uint8_t seg) {
-  uint8_t* ptr = (uint8_t*)memchr(_active_segments, seg, _active_segments_len);
-  if(ptr != NULL) return; // segment already active
+  if(seg >= _segments_len) return;
+  if(_segment_slots[seg] != INACTIVE_SEGMENT) return; // segment already active
   for(uint8_t i=0; i<_active_segments_len; i++) {
     if(_active_segments[i] == INACTIVE_SEGMENT) {
       _active_segments[i] = seg;
+      _segment_slots[seg] = i;
       resetSegmentRuntime(seg);
       break;
     }
@@ -474,80 +891,128 @@ void WS2812FX::addActiveSegment(uint8_t seg) {
 }
 
 void WS2812FX::removeActiveSegment(uint8_t seg) {
-  for(uint8_t i=0; i<_active_segments_len; i++) {
-    if(_active_segments[i] == seg) {
-      _active_segments[i] = INACTIVE_SEGMENT;
-    }
-  }
+  uint8_t slot = segmentSlot(seg);
+  if(slot == INACTIVE_SEGMENT) return; // segment not active
+  _active_segments[slot] = INACTIVE_SEGMENT;
+  _segment_slots[seg] = INACTIVE_SEGMENT;
+  _deadlines_dirty = true;
 }
 
 void WS2812FX::swapActiveSegment(uint8_t oldSeg, uint8_t newSeg) {
-  uint8_t* ptr = (uint8_t*)memchr(_active_segments, newSeg, _active_segments_len);
-  if(ptr != NULL) return; // if newSeg is already active, don't swap
-  for(uint8_t i=0; i<_active_segments_len; i++) {
-    if(_active_segments[i] == oldSeg) {
-      _active_segments[i] = newSeg;
-
-      // reset all runtime parameters EXCEPT next_time,
-      // allowing the current animation frame to complete
-      segment_runtime seg_rt = _segment_runtimes[i];
-      seg_rt.counter_mode_step = 0;
-      seg_rt.counter_mode_call = 0;
-      seg_rt.aux_param = 0;
-      seg_rt.aux_param2 = 0;
-      seg_rt.aux_param3 = 0;
-      break;
-    }
-  }
+  if(newSeg >= _segments_len) return;
+  if(_segment_slots[newSeg] != INACTIVE_SEGMENT) return; // if newSeg is already active, don't swap
+  uint8_t slot = segmentSlot(oldSeg);
+  if(slot == INACTIVE_SEGMENT) return; // oldSeg not active
+  _active_segments[slot] = newSeg;
+  _segment_slots[oldSeg] = INACTIVE_SEGMENT;
+  _segment_slots[newSeg] = slot;
+
+  // reset all runtime parameters EXCEPT next_time,
+  // allowing the current animation frame to complete
+  segment_runtime* seg_rt = &_segment_runtimes[slot];
+  seg_rt->counter_mode_step = 0;
+  seg_rt->counter_mode_call = 0;
+  seg_rt->aux_param = 0;
+  seg_rt->aux_param2 = 0;
+  seg_rt->aux_param3 = 0;
 }
 
 bool WS2812FX::isActiveSegment(uint8_t seg) {
-  uint8_t* ptr = (uint8_t*)memchr(_active_segments, seg, _active_segments_len);
-  if(ptr != NULL) return true;
-  return false;
+  return segmentSlot(seg) != INACTIVE_SEGMENT;
 }
 
 void WS2812FX::resetSegments() {
   resetSegmentRuntimes();
   memset(_segments, 0, _segments_len * sizeof(Segment));
   memset(_active_segments, INACTIVE_SEGMENT, _active_segments_len);
+  memset(_segment_slots, INACTIVE_SEGMENT, _segments_len);
   _num_segments = 0;
 }
 
 void WS2812FX::resetSegmentRuntimes() {
   memset(_segment_runtimes, 0, _active_segments_len * sizeof(Segment_runtime));
+  _frame_segments_len = 0;
+  _deadlines_dirty = true;
 }
 
 void WS2812FX::resetSegmentRuntime(uint8_t seg) {
-  uint8_t* ptr = (uint8_t*)memchr(_active_segments, seg, _active_segments_len);
-  if(ptr == NULL) return; // segment not active
-  memset(&_segment_runtimes[ptr - _active_segments], 0, sizeof(Segment_runtime));
+  uint8_t slot = segmentSlot(seg);
+  if(slot == INACTIVE_SEGMENT) return; // segment not active
+  memset(&_segment_runtimes[slot], 0, sizeof(Segment_runtime));
+  _deadlines_dirty = true;
+}
+
+// the tables are laid out largest alignment first, so they pack without padding
+static_assert(sizeof(WS2812FX::Segment) % alignof(WS2812FX::Segment_runtime) == 0, "segment table padding");
+static_assert(sizeof(WS2812FX::Segment_runtime) % alignof(void*) == 0, "runtime table padding");
+static_assert(MODE_STATE_SIZE % alignof(void*) == 0, "MODE_STATE_SIZE must keep each segment's state aligned");
+
+/*
+ * Changes the maximum number of segments, and of active segments, placing
+ * the segment tables in the caller's block of segmentArenaSize() bytes
+ * (which must stay valid), or in a single heap block if arena is NULL.
+ * All segments are reset, and segment 0 set to the whole strip like a newly
+ * constructed WS2812FX. Reconfiguring into the same arena again and again
+ * never allocates. Palette wheels aren't part of the arena: they're freed
+ * here, and setPalette() allocates them again on the heap.
+ */
+void WS2812FX::setSegmentArena(void *arena, uint8_t max_num_segments, uint8_t max_num_active_segments) {
+  freePaletteWheels();
+  delete[] _segment_block;
+  _segment_block = NULL;
+  _mode_state = NULL;
+
+  size_t size = segmentArenaSize(max_num_segments, max_num_active_segments);
+  if(arena == NULL) arena = _segment_block = new uint8_t[size];
+  memset(arena, 0, size);
+
+  uintptr_t p = ((uintptr_t)arena + alignof(segment) - 1) & ~(uintptr_t)(alignof(segment) - 1);
+  _segments = (segment*)p;
+  p += max_num_segments * sizeof(segment);
+  _segment_runtimes = (segment_runtime*)p;
+  p += max_num_active_segments * sizeof(segment_runtime);
+  _deadlines = (deadline*)p;
+  p += max_num_active_segments * sizeof(deadline);
+  _mode_state_data = (uint8_t*)p;
+  p += max_num_active_segments * MODE_STATE_SIZE;
+  _mode_states = (mode_state*)p;
+  p += max_num_active_segments * sizeof(mode_state);
+  _active_segments = (uint8_t*)p;
+  p += max_num_active_segments;
+  _frame_segments = (uint8_t*)p;
+  p += max_num_active_segments;
+  _segment_slots = (uint8_t*)p;
+
+  _segments_len = max_num_segments;
+  _active_segments_len = max_num_active_segments;
+  _deadlines_len = 0;
+  _frame_segments_len = 0;
+
+  // init segment pointers
+  _seg     = _segments;
+  _seg_rt  = _segment_runtimes;
+
+  resetSegments();
+  setSegment(0, 0, numPixels() - 1, DEFAULT_MODE, DEFAULT_COLOR, DEFAULT_SPEED, NO_OPTIONS);
+}
+
+void WS2812FX::freePaletteWheels(void) {
+  if(_palette_wheels == NULL) return;
+  for(uint8_t i=0; i < _segments_len; i++) delete[] _palette_wheels[i];
+  delete[] _palette_wheels;
+  _palette_wheels = NULL;
 }
 
 /*
  * Turns everything off. Doh.
  */
 void WS2812FX::strip_off() {
-  WS2812Serial::clear();
+  clear();
   show();
 }
 
-/*
- * Put a value 0 to 255 in to get a color value.
- * The colours are a transition r -> g -> b -> back to r
- * Inspired by the Adafruit examples.
- */
-uint32_t WS2812FX::color_wheel(uint8_t pos) {
-  pos = 255 - pos;
-  if(pos < 85) {
-    return ((uint32_t)(255 - pos * 3) << 16) | ((uint32_t)(0) << 8) | (pos * 3);
-  } else if(pos < 170) {
-    pos -= 85;
-    return ((uint32_t)(0) << 16) | ((uint32_t)(pos * 3) << 8) | (255 - pos * 3);
-  } else {
-    pos -= 170;
-    return ((uint32_t)(pos * 3) << 16) | ((uint32_t)(255 - pos * 3) << 8) | (0);
-  }
+void WS2812FX::clear(void) {
+  memset(getPixels(), 0, getNumBytes());
 }
 
 /*
@@ -654,11 +1119,11 @@ uint16_t WS2812FX::blink(uint32_t color1, uint32_t color2, bool strobe) {
     uint32_t color = (IS_REVERSE) ? color1 : color2; // off
     fill(color, _seg->start, _seg_len);
     SET_CYCLE;
-    return strobe ? _seg->speed - 20 : (_seg->speed / 2);
+    return strobe ? _seg->speed - min(msDelay(20), _seg->speed) : (_seg->speed / 2);
   } else {
     uint32_t color = (IS_REVERSE) ? color2 : color1; // on
     fill(color, _seg->start, _seg_len);
-    return strobe ? 20 : (_seg->speed / 2);
+    return strobe ? msDelay(20) : (_seg->speed / 2);
   }
 }
 
@@ -804,8 +1269,13 @@ uint16_t WS2812FX::mode_single_dynamic(void) {
  * to new random colors.
  */
 uint16_t WS2812FX::mode_multi_dynamic(void) {
-  for(uint16_t i=_seg->start; i <= _seg->stop; i++) {
-    setPixelColor(i, color_wheel(random8()));
+  uint32_t colors[SPAN_CHUNK_SIZE];
+  for(uint16_t i=0; i < _seg_len; i += SPAN_CHUNK_SIZE) {
+    uint16_t count = min(SPAN_CHUNK_SIZE, _seg_len - i);
+    for(uint16_t j=0; j < count; j++) {
+      colors[j] = color_wheel(random8());
+    }
+    writeSpan(_seg->start + i, count, colors);
   }
   SET_CYCLE;
   return _seg->speed;
@@ -838,7 +1308,7 @@ uint16_t WS2812FX::mode_breath(void) {
     _seg_rt->counter_mode_step = 15;
     SET_CYCLE;
   }
-  return delay;
+  return msDelay(delay);
 }
 
 
@@ -925,9 +1395,26 @@ uint16_t WS2812FX::mode_rainbow(void) {
  * Cycles a rainbow over the entire string of LEDs.
  */
 uint16_t WS2812FX::mode_rainbow_cycle(void) {
-  for(uint16_t i=0; i < _seg_len; i++) {
-	  uint32_t color = color_wheel(((i * 256 / _seg_len) + _seg_rt->counter_mode_step) & 0xFF);
-    setPixelColor(_seg->start + i, color);
+  // step the hue of each LED, i * 256 / _seg_len + counter_mode_step,
+  // incrementally (like a Bresenham line) rather than dividing per LED
+  uint16_t hueStep = 256 / _seg_len;
+  uint16_t hueRem  = 256 % _seg_len;
+  uint32_t err = 0;
+  uint8_t hue = _seg_rt->counter_mode_step;
+
+  uint32_t colors[SPAN_CHUNK_SIZE];
+  for(uint16_t i=0; i < _seg_len; i += SPAN_CHUNK_SIZE) {
+    uint16_t count = min(SPAN_CHUNK_SIZE, _seg_len - i);
+    for(uint16_t j=0; j < count; j++) {
+      colors[j] = color_wheel(hue);
+      hue += hueStep;
+      err += hueRem;
+      if(err >= _seg_len) {
+        err -= _seg_len;
+        hue++;
+      }
+    }
+    writeSpan(_seg->start + i, count, colors);
   }
 
   _seg_rt->counter_mode_step = (_seg_rt->counter_mode_step + 1) & 0xFF;
@@ -1073,49 +1560,67 @@ void WS2812FX::fade_out(uint32_t targetColor) {
   uint8_t rateH = rateMapH[rate];
   uint8_t rateL = rateMapL[rate];
 
-  uint32_t color = targetColor;
-  int w2 = (color >> 24) & 0xff;
-  int r2 = (color >> 16) & 0xff;
-  int g2 = (color >>  8) & 0xff;
-  int b2 =  color        & 0xff;
+  // fade the segment's bytes in place. They're already gamma corrected and
+  // brightness scaled, so reading them back through getPixelColor() and
+  // writing them with setPixelColor() would apply both again every frame.
+  uint8_t *pixels = getPixels() + _seg->start * bytesPerPixel;
+  uint16_t numBytes = _seg_len * bytesPerPixel;
+
+  if(rate == 0) { // old fade-to-black algorithm
+    uint16_t i = 0;
+    for(; i + 4 <= numBytes; i += 4) { // four bytes at a time
+      uint32_t word;
+      memcpy(&word, pixels + i, sizeof(word));
+      word = (word >> 1) & 0x7F7F7F7F;
+      memcpy(pixels + i, &word, sizeof(word));
+    }
+    for(; i < numBytes; i++) {
+      pixels[i] >>= 1;
+    }
+  } else { // new fade-to-color algorithm
+    // the target color, gamma corrected and brightness scaled like the pixels,
+    // in the draw buffer's byte order (B, G, R, W)
+    const uint8_t *lut = pixelLut();
+    uint8_t target[4];
+    for(uint8_t k=0; k < 4; k++) {
+      target[k] = lut[(targetColor >> (k * 8)) & 0xff];
+    }
 
-  for(uint16_t i=_seg->start; i <= _seg->stop; i++) {
-    color = getPixelColor(i); // current color
-    if(rate == 0) { // old fade-to-black algorithm
-      setPixelColor(i, (color >> 1) & 0x7F7F7F7F);
-    } else { // new fade-to-color algorithm
-      int w1 = (color >> 24) & 0xff;
-      int r1 = (color >> 16) & 0xff;
-      int g1 = (color >>  8) & 0xff;
-      int b1 =  color        & 0xff;
-
-      // calculate the color differences between the current and target colors
-      int wdelta = w2 - w1;
-      int rdelta = r2 - r1;
-      int gdelta = g2 - g1;
-      int bdelta = b2 - b1;
-
-      // if the current and target colors are almost the same, jump right to the target
-      // color, otherwise calculate an intermediate color. (fixes rounding issues)
-      wdelta = abs(wdelta) < 3 ? wdelta : (wdelta >> rateH) + (wdelta >> rateL);
-      rdelta = abs(rdelta) < 3 ? rdelta : (rdelta >> rateH) + (rdelta >> rateL);
-      gdelta = abs(gdelta) < 3 ? gdelta : (gdelta >> rateH) + (gdelta >> rateL);
-      bdelta = abs(bdelta) < 3 ? bdelta : (bdelta >> rateH) + (bdelta >> rateL);
-
-      setPixelColor(i, r1 + rdelta, g1 + gdelta, b1 + bdelta, w1 + wdelta);
+    for(uint16_t i=0; i < numBytes; i += bytesPerPixel) {
+      for(uint8_t k=0; k < bytesPerPixel; k++) {
+        // calculate the difference between the current and target colors.
+        // if they're almost the same, jump right to the target color,
+        // otherwise calculate an intermediate color. (fixes rounding issues)
+        int delta = target[k] - pixels[i + k];
+        pixels[i + k] += abs(delta) < 3 ? delta : (delta >> rateH) + (delta >> rateL);
+      }
     }
   }
 }
 
 
+#if defined(__ARM_ARCH_7EM__) // Cortex-M4/M7 DSP extension
 /*
- * color blend function
+ * Blends the four bytes of two words at once, with exactly the same result
+ * as blendAmt * (s2 - s1) / 256 + s1 for each byte. uqsub8 gives the per byte
+ * differences s2 - s1 and s1 - s2 (one of them zero), which are scaled in two
+ * 16-bit lanes per word (even and odd bytes) and added or subtracted, so the
+ * division rounds toward zero like the signed version.
  */
-uint32_t WS2812FX::color_blend(uint32_t color1, uint32_t color2, uint8_t blendAmt) {
-  uint32_t blendedColor;
-  blend((uint8_t*)&blendedColor, (uint8_t*)&color1, (uint8_t*)&color2, sizeof(uint32_t), blendAmt);
-  return blendedColor;
+static inline uint32_t blendWord(uint32_t s1, uint32_t s2, uint8_t blendAmt) {
+  uint32_t up, down;
+  asm("uqsub8 %0, %1, %2" : "=r" (up) : "r" (s2), "r" (s1));
+  asm("uqsub8 %0, %1, %2" : "=r" (down) : "r" (s1), "r" (s2));
+
+  uint32_t even = (s1 & 0x00FF00FF)
+    + ((((up & 0x00FF00FF) * blendAmt) >> 8) & 0x00FF00FF)
+    - ((((down & 0x00FF00FF) * blendAmt) >> 8) & 0x00FF00FF);
+  uint32_t odd = ((s1 >> 8) & 0x00FF00FF)
+    + (((((up >> 8) & 0x00FF00FF) * blendAmt) >> 8) & 0x00FF00FF)
+    - (((((down >> 8) & 0x00FF00FF) * blendAmt) >> 8) & 0x00FF00FF);
+  return even | (odd << 8);
 }
+#endif
 
 uint8_t* WS2812FX::blend(uint8_t *dest, uint8_t *src1, uint8_t *src2, uint16_t cnt, uint8_t blendAmt) {
   if(blendAmt == 0) {
@@ -1123,7 +1628,18 @@ uint8_t* WS2812FX::blend(uint8_t *dest, uint8_t *src1, uint8_t *src2, uint16_t c
   } else if(blendAmt == 255) {
     memmove(dest, src2, cnt);
   } else {
-    for(uint16_t i=0; i<cnt; i++) {
+    uint16_t i = 0;
+#if defined(__ARM_ARCH_7EM__)
+    for(; i + 4 <= cnt; i += 4) { // four bytes at a time
+      uint32_t s1, s2;
+      memcpy(&s1, src1 + i, sizeof(s1));
+      memcpy(&s2, src2 + i, sizeof(s2));
+      s1 = blendWord(s1, s2, blendAmt);
+      memcpy(dest + i, &s1, sizeof(s1));
+    }
+#endif
+    // (elsewhere, e.g. the host build, the compiler vectorizes this loop itself)
+    for(; i<cnt; i++) {
 //    dest[i] = map(blendAmt, 0, 255, src1[i], src2[i]);
       dest[i] =  blendAmt * ((int)src2[i] - (int)src1[i]) / 256 + src1[i]; // map() function
     }
@@ -1237,7 +1753,7 @@ uint16_t WS2812FX::mode_multi_strobe(void) {
 
   _seg_rt->counter_mode_step = (_seg_rt->counter_mode_step + 1) % (count + 1);
   if(_seg_rt->counter_mode_step == 0) SET_CYCLE;
-  return delay;
+  return msDelay(delay);
 }
 
 
@@ -1369,7 +1885,7 @@ uint16_t WS2812FX::chase_flash(uint32_t color1, uint32_t color2) {
       setPixelColor(_seg->start + n, color);
       setPixelColor(_seg->start + m, color);
     }
-    return 30;
+    return msDelay(30);
   } else {
     _seg_rt->counter_mode_step = (_seg_rt->counter_mode_step + 1) % _seg_len;
     if(_seg_rt->counter_mode_step == 0) {
@@ -1701,54 +2217,164 @@ uint16_t WS2812FX::mode_twinkleFOX(void) {
   return _seg->speed / 32;
 }
 
+// define static array of member function pointers.
+// function pointers MUST be in the same order as the corresponding name in the _name array.
+static WS2812FX::mode_ptr _modes[MODE_COUNT] = {
+  &WS2812FX::mode_static,
+  &WS2812FX::mode_blink,
+  &WS2812FX::mode_breath,
+  &WS2812FX::mode_color_wipe,
+  &WS2812FX::mode_color_wipe_inv,
+  &WS2812FX::mode_color_wipe_rev,
+  &WS2812FX::mode_color_wipe_rev_inv,
+  &WS2812FX::mode_color_wipe_random,
+  &WS2812FX::mode_random_color,
+  &WS2812FX::mode_single_dynamic,
+  &WS2812FX::mode_multi_dynamic,
+  &WS2812FX::mode_rainbow,
+  &WS2812FX::mode_rainbow_cycle,
+  &WS2812FX::mode_scan,
+  &WS2812FX::mode_dual_scan,
+  &WS2812FX::mode_fade,
+  &WS2812FX::mode_theater_chase,
+  &WS2812FX::mode_theater_chase_rainbow,
+  &WS2812FX::mode_running_lights,
+  &WS2812FX::mode_twinkle,
+  &WS2812FX::mode_twinkle_random,
+  &WS2812FX::mode_twinkle_fade,
+  &WS2812FX::mode_twinkle_fade_random,
+  &WS2812FX::mode_sparkle,
+  &WS2812FX::mode_flash_sparkle,
+  &WS2812FX::mode_hyper_sparkle,
+  &WS2812FX::mode_strobe,
+  &WS2812FX::mode_strobe_rainbow,
+  &WS2812FX::mode_multi_strobe,
+  &WS2812FX::mode_blink_rainbow,
+  &WS2812FX::mode_chase_white,
+  &WS2812FX::mode_chase_color,
+  &WS2812FX::mode_chase_random,
+  &WS2812FX::mode_chase_rainbow,
+  &WS2812FX::mode_chase_flash,
+  &WS2812FX::mode_chase_flash_random,
+  &WS2812FX::mode_chase_rainbow_white,
+  &WS2812FX::mode_chase_blackout,
+  &WS2812FX::mode_chase_blackout_rainbow,
+  &WS2812FX::mode_color_sweep_random,
+  &WS2812FX::mode_running_color,
+  &WS2812FX::mode_running_red_blue,
+  &WS2812FX::mode_running_random,
+  &WS2812FX::mode_larson_scanner,
+  &WS2812FX::mode_comet,
+  &WS2812FX::mode_fireworks,
+  &WS2812FX::mode_fireworks_random,
+  &WS2812FX::mode_merry_christmas,
+  &WS2812FX::mode_fire_flicker,
+  &WS2812FX::mode_fire_flicker_soft,
+  &WS2812FX::mode_fire_flicker_intense,
+  &WS2812FX::mode_circus_combustus,
+  &WS2812FX::mode_halloween,
+  &WS2812FX::mode_bicolor_chase,
+  &WS2812FX::mode_tricolor_chase,
+  &WS2812FX::mode_twinkleFOX
+};
+
 /*
  * Custom modes
  */
-uint16_t WS2812FX::mode_custom_0() {
-  return customModes[0]();
-}
-uint16_t WS2812FX::mode_custom_1() {
-  return customModes[1]();
+uint16_t WS2812FX::runMode(void) {
+  if(_seg->mode < FX_MODE_CUSTOM_0) return (this->*_modes[_seg->mode])();
+
+  // custom modes are called straight through their registered pointer
+  const custom_mode* cm = customMode(_seg->mode);
+  if(cm != NULL && cm->fn != NULL) return cm->fn(*this, _seg, _seg_rt);
+  if(cm != NULL && cm->legacy_fn != NULL) return cm->legacy_fn();
+  return msDelay(1000); // nothing registered for this mode
+}
+
+// the registry entry for custom mode index, growing the registry to hold it
+// if need be, or NULL if index is out of range
+WS2812FX::custom_mode* WS2812FX::customModeSlot(uint8_t index) {
+  if(index >= MAX_CUSTOM_MODES) return NULL;
+
+  if(index >= _custom_modes_capacity) { // double the capacity, so registering dozens of modes doesn't churn the heap
+    uint8_t capacity = max(_custom_modes_capacity, (uint8_t)4);
+    while(capacity <= index) capacity = min(capacity * 2, MAX_CUSTOM_MODES);
+    custom_mode* modes = new custom_mode[capacity];
+    if(_custom_modes_len > 0) memcpy(modes, _custom_modes, _custom_modes_len * sizeof(custom_mode));
+    delete[] _custom_modes;
+    _custom_modes = modes;
+    _custom_modes_capacity = capacity;
+  }
+
+  while(_custom_modes_len <= index) { // slots skipped over stay empty
+    _custom_modes[_custom_modes_len++] = { NULL, NULL, NULL, 0 };
+  }
+  return &_custom_modes[index];
 }
-uint16_t WS2812FX::mode_custom_2() {
-  return customModes[2]();
+
+/*
+ * Custom mode helpers
+ */
+void WS2812FX::setCustomMode(uint16_t (*p)()) {
+  custom_mode* cm = customModeSlot(0);
+  cm->fn = NULL;
+  cm->legacy_fn = p;
 }
-uint16_t WS2812FX::mode_custom_3() {
-  return customModes[3]();
+
+void WS2812FX::setCustomMode(custom_mode_ptr p) {
+  custom_mode* cm = customModeSlot(0);
+  cm->fn = p;
+  cm->legacy_fn = NULL;
 }
-uint16_t WS2812FX::mode_custom_4() {
-  return customModes[4]();
+
+uint8_t WS2812FX::setCustomMode(const __FlashStringHelper* name, uint16_t (*p)()) {
+  return setCustomMode(name, p, 0);
 }
-uint16_t WS2812FX::mode_custom_5() {
-  return customModes[5]();
+
+// stateSize is the number of bytes of state the custom mode keeps for each
+// segment it runs on (see getModeState()), up to MODE_STATE_SIZE. Returns 0
+// if the mode can't be registered.
+uint8_t WS2812FX::setCustomMode(const __FlashStringHelper* name, uint16_t (*p)(), uint16_t stateSize) {
+  return setCustomMode(_custom_modes_len, name, p, stateSize);
 }
-uint16_t WS2812FX::mode_custom_6() {
-  return customModes[6]();
+
+uint8_t WS2812FX::setCustomMode(uint8_t index, const __FlashStringHelper* name, uint16_t (*p)()) {
+  return setCustomMode(index, name, p, 0);
 }
-uint16_t WS2812FX::mode_custom_7() {
-  return customModes[7]();
+
+uint8_t WS2812FX::setCustomMode(uint8_t index, const __FlashStringHelper* name, uint16_t (*p)(), uint16_t stateSize) {
+  if(stateSize > MODE_STATE_SIZE) return 0;
+  custom_mode* cm = customModeSlot(index);
+  if(cm == NULL) return 0;
+
+  *cm = { NULL, p, name, stateSize };
+  return (FX_MODE_CUSTOM_0 + index);
 }
 
 /*
- * Custom mode helpers
+ * Same as above, for custom modes that take the WS2812FX instance, segment
+ * and segment runtime they render as parameters, rather than relying on a
+ * global WS2812FX instance, so they can run on any number of instances.
  */
-void WS2812FX::setCustomMode(uint16_t (*p)()) {
-  customModes[0] = p;
+uint8_t WS2812FX::setCustomMode(const __FlashStringHelper* name, custom_mode_ptr p) {
+  return setCustomMode(name, p, 0);
 }
 
-uint8_t WS2812FX::setCustomMode(const __FlashStringHelper* name, uint16_t (*p)()) {
-  static uint8_t custom_mode_index = 0;
-  return setCustomMode(custom_mode_index++, name, p);
+uint8_t WS2812FX::setCustomMode(const __FlashStringHelper* name, custom_mode_ptr p, uint16_t stateSize) {
+  return setCustomMode(_custom_modes_len, name, p, stateSize);
 }
 
-uint8_t WS2812FX::setCustomMode(uint8_t index, const __FlashStringHelper* name, uint16_t (*p)()) {
-  if((uint8_t)(FX_MODE_CUSTOM_0 + index) < MODE_COUNT) {
-    _names[FX_MODE_CUSTOM_0 + index] = name; // store the custom mode name
-    customModes[index] = p; // store the custom mode
+uint8_t WS2812FX::setCustomMode(uint8_t index, const __FlashStringHelper* name, custom_mode_ptr p) {
+  return setCustomMode(index, name, p, 0);
+}
 
-    return (FX_MODE_CUSTOM_0 + index);
-  }
-  return 0;
+uint8_t WS2812FX::setCustomMode(uint8_t index, const __FlashStringHelper* name, custom_mode_ptr p, uint16_t stateSize) {
+  if(stateSize > MODE_STATE_SIZE) return 0;
+  custom_mode* cm = customModeSlot(index);
+  if(cm == NULL) return 0;
+
+  *cm = { p, NULL, name, stateSize };
+  return (FX_MODE_CUSTOM_0 + index);
 }
 
 /*
@@ -1759,24 +2385,64 @@ void WS2812FX::setCustomShow(void (*p)()) {
 }
 
 void WS2812FX::fill(uint32_t c, uint16_t first, uint16_t count) {
-  uint16_t i, end;
-
   if(first >= numPixels()) {
     return; // If first LED is past end of strip, nothing to do
   }
 
-  // Calculate the index ONE AFTER the last pixel to fill
-  if(count == 0) {
-    // Fill to end of strip
-    end = numPixels();
+  // Fill to end of strip
+  if(count == 0) count = numPixels() - first;
+
+  fillSpan(first, count, c);
+}
+
+/*
+ * Bulk pixel writers. The segment's gamma/brightness lookup table and the
+ * strip's bytes per pixel are resolved once per call, then the colors are
+ * stored straight into the draw buffer, skipping the per-pixel
+ * setPixelColor() call chain. Color order is applied by WS2812Serial::show().
+ */
+void WS2812FX::fillSpan(uint16_t first, uint16_t count, uint32_t c) {
+  if(first >= numPixels()) return;
+  if(count > numPixels() - first) count = numPixels() - first;
+
+  const uint8_t *lut = pixelLut();
+  uint8_t w = lut[(c >> 24) & 0xFF], r = lut[(c >> 16) & 0xFF], g = lut[(c >> 8) & 0xFF], b = lut[c & 0xFF];
+
+  uint8_t *p = getPixels() + first * bytesPerPixel;
+  uint8_t *end = p + count * bytesPerPixel;
+  if(bytesPerPixel == 4) {
+    for(; p < end; p += 4) {
+      p[0] = b; p[1] = g; p[2] = r; p[3] = w;
+    }
   } else {
-    // Ensure that the loop won't go past the last pixel
-    end = first + count;
-    if(end > numPixels()) end = numPixels();
+    for(; p < end; p += 3) {
+      p[0] = b; p[1] = g; p[2] = r;
+    }
   }
+}
 
-  for(i = first; i < end; i++) {
-    this->setPixelColor(i, c);
+void WS2812FX::writeSpan(uint16_t first, uint16_t count, const uint32_t* colors) {
+  if(first >= numPixels()) return;
+  if(count > numPixels() - first) count = numPixels() - first;
+
+  const uint8_t *lut = pixelLut();
+  uint8_t *p = getPixels() + first * bytesPerPixel;
+  const uint32_t *end = colors + count;
+  if(bytesPerPixel == 4) {
+    for(; colors < end; colors++, p += 4) {
+      uint32_t c = *colors;
+      p[0] = lut[c & 0xFF];
+      p[1] = lut[(c >>  8) & 0xFF];
+      p[2] = lut[(c >> 16) & 0xFF];
+      p[3] = lut[(c >> 24) & 0xFF];
+    }
+  } else {
+    for(; colors < end; colors++, p += 3) {
+      uint32_t c = *colors;
+      p[0] = lut[c & 0xFF];
+      p[1] = lut[(c >>  8) & 0xFF];
+      p[2] = lut[(c >> 16) & 0xFF];
+    }
   }
 }
 
@@ -1785,11 +2451,24 @@ uint32_t WS2812FX::getPixelColor(uint16_t n) const {
 
   n *= bytesPerPixel;
 
-  uint32_t color = drawBuffer[n];
-  color += drawBuffer[n + 1] << 8;
-  color += drawBuffer[n + 2] << 16;
+  const uint8_t *pixels = getPixels();
+  uint32_t color = pixels[n];
+  color += pixels[n + 1] << 8;
+  color += pixels[n + 2] << 16;
   if (bytesPerPixel == 4) {
-    color += drawBuffer[n + 3] << 24;
+    color += pixels[n + 3] << 24;
+  }
+
+  if(_brightness != BRIGHTNESS_MAX && _linear_buffer == NULL) { // undo the brightness scaling (lossy)
+    // round up, to the smallest value that scales back to the stored one,
+    // so a getPixelColor()/setPixelColor() round trip doesn't change the pixel
+    uint16_t mult = _brightness + 1;
+    uint32_t unscaled = 0;
+    for(uint8_t shift=0; shift < 32; shift += 8) {
+      uint16_t c = (((uint16_t)((color >> shift) & 0xFF) << 8) + mult - 1) / mult;
+      unscaled |= (uint32_t)(c > 255 ? 255 : c) << shift;
+    }
+    color = unscaled;
   }
 
   return color;
@@ -58,17 +58,32 @@
   #define SPEED_MIN (uint16_t)10
 #endif
 #define SPEED_MAX (uint16_t)65535
+#define SPEED_MIN_MICROS (uint16_t)100 /* frame delay floor of TIME_MICROS segments */
 
 #define BRIGHTNESS_MIN (uint8_t)0
 #define BRIGHTNESS_MAX (uint8_t)255
 
-/* each segment uses 36 bytes of SRAM memory, so if you're compile fails
-  because of insufficient flash memory, decreasing MAX_NUM_SEGMENTS may help */
+/* default segment counts, for the constructor's max_num_segments and
+  max_num_active_segments parameters (up to 255 each). Each segment uses 25
+  bytes of SRAM, and each active segment 30 more plus MODE_STATE_SIZE, so if
+  you run out of memory, decreasing MAX_NUM_SEGMENTS may help. Define them
+  before including WS2812FX.h to change the defaults. */
+#ifndef MAX_NUM_SEGMENTS
 #define MAX_NUM_SEGMENTS         10
+#endif
+#ifndef MAX_NUM_ACTIVE_SEGMENTS
 #define MAX_NUM_ACTIVE_SEGMENTS  10
+#endif
+/* bytes of custom mode state each active segment has room for (see
+  getModeState()). The largest of the effects in src/custom, Popcorn, needs
+  124. Sketches that don't use those effects can define it smaller. */
+#ifndef MODE_STATE_SIZE
+#define MODE_STATE_SIZE         128
+#endif
 #define INACTIVE_SEGMENT        255 /* max uint_8 */
 #define MAX_NUM_COLORS            3 /* number of colors per segment */
-#define MAX_CUSTOM_MODES          8
+#define MAX_CUSTOM_MODES        199 /* custom modes ids run from FX_MODE_CUSTOM_0 to 254 */
+#define SPAN_CHUNK_SIZE          32 /* colors rendered per writeSpan() call */
 
 // some common colors
 #define RED        (uint32_t)0xFF0000
@@ -93,7 +108,7 @@
 // bits 4-6: fade rate (0-7)
 // bit    3: gamma correction
 // bits 1-2: size
-// bits   0: TBD
+// bits   0: microsecond timing
 #define NO_OPTIONS   (uint8_t)B00000000
 #define REVERSE      (uint8_t)B10000000
 #define IS_REVERSE   ((_seg->options & REVERSE) == REVERSE)
@@ -112,6 +127,8 @@
 #define SIZE_LARGE   (uint8_t)B00000100
 #define SIZE_XLARGE  (uint8_t)B00000110
 #define SIZE_OPTION  ((_seg->options >> 1) & 3)
+#define TIME_MICROS  (uint8_t)B00000001
+#define IS_TIME_MICROS ((_seg->options & TIME_MICROS) == TIME_MICROS)
 
 // segment runtime options (aux_param2)
 #define FRAME           (uint8_t)B10000000
@@ -122,7 +139,7 @@
 #define CLR_CYCLE       (_seg_rt->aux_param2 &= ~CYCLE)
 #define CLR_FRAME_CYCLE (_seg_rt->aux_param2 &= ~(FRAME | CYCLE))
 
-#define MODE_COUNT (sizeof(_names)/sizeof(_names[0]))
+#define MODE_COUNT (sizeof(_names)/sizeof(_names[0])) /* builtin modes, see getModeCount() */
 
 #define FX_MODE_STATIC                   0
 #define FX_MODE_BLINK                    1
@@ -249,14 +266,6 @@ const char name_52[] PROGMEM = "Halloween";
 const char name_53[] PROGMEM = "Bicolor Chase";
 const char name_54[] PROGMEM = "Tricolor Chase";
 const char name_55[] PROGMEM = "TwinkleFOX";
-const char name_56[] PROGMEM = "Custom 0"; // custom modes need to go at the end
-const char name_57[] PROGMEM = "Custom 1";
-const char name_58[] PROGMEM = "Custom 2";
-const char name_59[] PROGMEM = "Custom 3";
-const char name_60[] PROGMEM = "Custom 4";
-const char name_61[] PROGMEM = "Custom 5";
-const char name_62[] PROGMEM = "Custom 6";
-const char name_63[] PROGMEM = "Custom 7";
 
 static const __FlashStringHelper* _names[] = {
   FSH(name_0),
@@ -314,15 +323,7 @@ static const __FlashStringHelper* _names[] = {
   FSH(name_52),
   FSH(name_53),
   FSH(name_54),
-  FSH(name_55),
-  FSH(name_56),
-  FSH(name_57),
-  FSH(name_58),
-  FSH(name_59),
-  FSH(name_60),
-  FSH(name_61),
-  FSH(name_62),
-  FSH(name_63)
+  FSH(name_55)
 };
 
 /* A PROGMEM (flash mem) table containing 8-bit unsigned sine wave (0-255).
@@ -376,24 +377,47 @@ static const uint8_t PROGMEM _NeoPixelGammaTable[256] = {
 182,184,186,188,191,193,195,197,199,202,204,206,209,211,213,215,
 218,220,223,225,227,230,232,235,237,240,242,245,247,250,252,255};
 
+/* The default color wheel used by color_wheel(), a transition r -> g -> b ->
+   back to r, as a table of 256 colors generated at compile time.
+*/
+struct ColorWheelTable {
+  constexpr ColorWheelTable() : colors() {
+    for(uint16_t i=0; i < 256; i++) {
+      uint8_t pos = 255 - i;
+      if(pos < 85) {
+        colors[i] = ((uint32_t)(255 - pos * 3) << 16) | (pos * 3);
+      } else if(pos < 170) {
+        pos -= 85;
+        colors[i] = ((uint32_t)(pos * 3) << 8) | (255 - pos * 3);
+      } else {
+        pos -= 170;
+        colors[i] = ((uint32_t)(pos * 3) << 16) | ((uint32_t)(255 - pos * 3) << 8);
+      }
+    }
+  }
+  uint32_t colors[256];
+};
+static constexpr ColorWheelTable PROGMEM _ColorWheelTable;
+
 class WS2812FX : public WS2812Serial {
 
   public:
     typedef uint16_t (WS2812FX::*mode_ptr)(void);
 
     // segment parameters
-    typedef struct Segment { // 20 bytes
+    typedef struct Segment { // 24 bytes
       uint16_t start;
       uint16_t stop;
       uint16_t speed;
       uint8_t  mode;
       uint8_t  options;
       uint32_t colors[MAX_NUM_COLORS];
+      const uint32_t* wheel; // 256 color table for color_wheel() (NULL = default)
     } segment;
 
     // segment runtime parameters
     typedef struct Segment_runtime { // 16 bytes
-      unsigned long next_time;
+      unsigned long next_time; // micros() time of the next frame
       uint32_t counter_mode_step;
       uint32_t counter_mode_call;
       uint8_t aux_param;   // auxilary param (usually stores a color_wheel index)
@@ -401,9 +425,27 @@ class WS2812FX : public WS2812Serial {
       uint16_t aux_param3; // auxilary param (usually stores a segment index)
     } segment_runtime;
 
+    // custom mode that is passed the instance, segment and segment runtime it's
+    // rendering, so it can run on any WS2812FX (see setCustomMode())
+    typedef uint16_t (*custom_mode_ptr)(WS2812FX& fx, Segment* seg, Segment_runtime* segrt);
+
+    // palette of colors, expanded into a segment's color wheel by setPalette()
+    typedef struct Palette {
+      uint8_t num_stops;        // number of colors
+      const uint8_t* stops;     // wheel position of each color, ascending (NULL = evenly spaced)
+      const uint32_t* colors;   // the colors
+    } palette;
+
     WS2812FX(uint16_t num_leds, void *fb, void *db, uint8_t pin, uint8_t type,
       uint8_t max_num_segments=MAX_NUM_SEGMENTS,
       uint8_t max_num_active_segments=MAX_NUM_ACTIVE_SEGMENTS)
+      : WS2812FX(num_leds, fb, db, pin, type, NULL, max_num_segments, max_num_active_segments) {
+    };
+
+    // same, but with the segment tables placed in a caller owned block of
+    // memory (e.g. DMAMEM or EXTMEM) of segmentArenaSize() bytes
+    WS2812FX(uint16_t num_leds, void *fb, void *db, uint8_t pin, uint8_t type,
+      void *arena, uint8_t max_num_segments, uint8_t max_num_active_segments)
       : WS2812Serial(num_leds, fb, db, pin, type) {
 
       drawBuffer = (uint8_t *) db;
@@ -414,24 +456,30 @@ class WS2812FX : public WS2812Serial {
 */
       _running = false;
 
-      _segments_len = max_num_segments;
-      _active_segments_len = max_num_active_segments;
-
-      // create all the segment arrays and init to zeros
-      _segments = new segment[_segments_len]();
-      _active_segments = new uint8_t[_active_segments_len]();
-      _segment_runtimes = new segment_runtime[_active_segments_len]();
+      _brightness = BRIGHTNESS_MAX;
+      updateLuts();
 
-      // init segment pointers
-      _seg     = _segments;
-      _seg_rt  = _segment_runtimes;
-
-      resetSegments();
-      setSegment(0, 0, num_leds - 1, DEFAULT_MODE, DEFAULT_COLOR, DEFAULT_SPEED, NO_OPTIONS);
+      setSegmentArena(arena, max_num_segments, max_num_active_segments);
     };
 
+    // an instance owns its heap allocated tables, so it can't be copied, only
+    // moved (which the WS2812FX ws2812fx = WS2812FX(...) idiom relies on
+    // before C++17)
+    WS2812FX(WS2812FX&& fx);
+    WS2812FX& operator=(const WS2812FX&) = delete;
+
+    ~WS2812FX(void);
+
+    // bytes of memory the segment tables and custom mode state need (but not
+    // palette wheels, see setPalette()), including room to align an
+    // unaligned arena
+    static constexpr size_t segmentArenaSize(uint8_t max_num_segments, uint8_t max_num_active_segments) {
+      return alignof(segment) - 1 +
+        max_num_segments * (sizeof(segment) + 1) +
+        max_num_active_segments * (sizeof(segment_runtime) + sizeof(deadline) + sizeof(mode_state) + MODE_STATE_SIZE + 2);
+    }
+
     void
-//    timer(void),
       init(void),
       start(void),
       stop(void),
@@ -444,6 +492,7 @@ class WS2812FX : public WS2812Serial {
       setMode(uint8_t seg, uint8_t m),
       setOptions(uint8_t seg, uint8_t o),
       setCustomMode(uint16_t (*p)()),
+      setCustomMode(custom_mode_ptr p),
       setCustomShow(void (*p)()),
       setSpeed(uint16_t s),
       setSpeed(uint8_t seg, uint16_t s),
@@ -454,7 +503,12 @@ class WS2812FX : public WS2812Serial {
       setColor(uint32_t c),
       setColor(uint8_t seg, uint32_t c),
       setColors(uint8_t seg, uint32_t* c),
+      setColorWheel(uint8_t seg, const uint32_t* wheel),
+      setPalette(uint8_t seg, const Palette* p),
       setBrightness(uint8_t b),
+      setRefreshRate(uint16_t hz),
+      setAsyncShow(bool b),
+      setDithering(bool b),
       increaseBrightness(uint8_t s),
       decreaseBrightness(uint8_t s),
 /*
@@ -500,26 +554,44 @@ class WS2812FX : public WS2812Serial {
 */
       setRandomSeed(uint16_t),
       fill(uint32_t c=0, uint16_t first=0, uint16_t count=0),
+      fillSpan(uint16_t first, uint16_t count, uint32_t c),
+      writeSpan(uint16_t first, uint16_t count, const uint32_t* colors),
+      setLinearBuffer(void *lb),
+      setSegmentArena(void *arena, uint8_t max_num_segments, uint8_t max_num_active_segments),
+      clear(void),
       show(void);
 
     bool
       service(void),
       isRunning(void),
       isTriggered(void),
+      isShowPending(void),
+      isDithering(void),
       isFrame(void),
       isFrame(uint8_t),
       isCycle(void),
       isCycle(uint8_t),
       isActiveSegment(uint8_t seg);
 
+    unsigned long
+      nextDeadline(void),
+      nextDeadlineMicros(void);
+
     uint8_t
       random8(void),
       random8(uint8_t),
+      getBrightness(void),
       getMode(void),
       getMode(uint8_t),
       getModeCount(void),
       setCustomMode(const __FlashStringHelper* name, uint16_t (*p)()),
+      setCustomMode(const __FlashStringHelper* name, uint16_t (*p)(), uint16_t stateSize),
       setCustomMode(uint8_t i, const __FlashStringHelper* name, uint16_t (*p)()),
+      setCustomMode(uint8_t i, const __FlashStringHelper* name, uint16_t (*p)(), uint16_t stateSize),
+      setCustomMode(const __FlashStringHelper* name, custom_mode_ptr p),
+      setCustomMode(const __FlashStringHelper* name, custom_mode_ptr p, uint16_t stateSize),
+      setCustomMode(uint8_t i, const __FlashStringHelper* name, custom_mode_ptr p),
+      setCustomMode(uint8_t i, const __FlashStringHelper* name, custom_mode_ptr p, uint16_t stateSize),
       getNumSegments(void),
       get_random_wheel_index(uint8_t),
       getOptions(uint8_t),
@@ -530,21 +602,24 @@ class WS2812FX : public WS2812Serial {
       random16(uint16_t),
       getSpeed(void),
       getSpeed(uint8_t),
+      getRefreshRate(void),
       getLength(void),
       getNumBytes(void);
 
     uint32_t
-      color_wheel(uint8_t),
       getColor(void),
       getColor(uint8_t),
       intensitySum(void),
       getPixelColor(uint16_t n) const;
 
     uint32_t* getColors(uint8_t);
+    const uint32_t* getColorWheel(uint8_t);
     uint32_t* intensitySums(void);
     uint8_t*  getActiveSegments(void);
     uint8_t*  blend(uint8_t*, uint8_t*, uint8_t*, uint16_t, uint8_t);
-    uint8_t*  getPixels(void) const { return drawBuffer; };
+
+    static void expandPalette(const Palette* p, uint32_t* wheel);
+    uint8_t*  getPixels(void) const { return _linear_buffer != NULL ? _linear_buffer : drawBuffer; };
 
     const __FlashStringHelper* getModeName(uint8_t m);
 
@@ -560,6 +635,8 @@ class WS2812FX : public WS2812Serial {
 
     WS2812FX::Segment_runtime* getSegmentRuntimes(void);
 
+    void* getModeState(void);
+
     // mode helper functions
     uint16_t
       blink(uint32_t, uint32_t, bool strobe),
@@ -575,9 +652,6 @@ class WS2812FX : public WS2812Serial {
       tricolor_chase(uint32_t, uint32_t, uint32_t),
       scan(uint32_t, uint32_t, bool);
 
-    uint32_t
-      color_blend(uint32_t, uint32_t, uint8_t);
-
     // builtin modes
     uint16_t
       mode_static(void),
@@ -635,15 +709,7 @@ class WS2812FX : public WS2812Serial {
       mode_circus_combustus(void),
       mode_bicolor_chase(void),
       mode_tricolor_chase(void),
-      mode_twinkleFOX(void),
-      mode_custom_0(void),
-      mode_custom_1(void),
-      mode_custom_2(void),
-      mode_custom_3(void),
-      mode_custom_4(void),
-      mode_custom_5(void),
-      mode_custom_6(void),
-      mode_custom_7(void);
+      mode_twinkleFOX(void);
 
     /*!
       @brief   An 8-bit integer sine wave function, not directly compatible
@@ -674,40 +740,180 @@ class WS2812FX : public WS2812Serial {
     static uint8_t    gamma8(uint8_t x) {
         return pgm_read_byte(&_NeoPixelGammaTable[x]); // 0-255 in, 0-255 out
     }
+    /*!
+      @brief   Look up a color on the current segment's color wheel. Unless
+               the segment was given its own table with setColorWheel(), the
+               colors are a transition r -> g -> b -> back to r.
+      @param   pos  Position on the wheel, 0 to 255.
+      @return  Packed color (0xWWRRGGBB).
+    */
+    uint32_t          color_wheel(uint8_t pos) {
+        return _seg->wheel != NULL ? _seg->wheel[pos] : _ColorWheelTable.colors[pos];
+    }
+    /*!
+      @brief   Blend two packed colors, each channel moving from color1 to
+               color2 by blendAmt/256 (rounded toward color1), the same as
+               blend() does for a byte buffer.
+      @param   color1    Color returned when blendAmt is 0.
+      @param   color2    Color returned when blendAmt is 255.
+      @param   blendAmt  Amount of color2, 0 to 255.
+      @return  Blended color, in the same 0xWWRRGGBB packing.
+    */
+    static uint32_t   color_blend(uint32_t color1, uint32_t color2, uint8_t blendAmt) {
+        if(blendAmt == 0) return color1;
+        if(blendAmt == 255) return color2;
+        return blendLanes(color1 & 0x00FF00FF, color2 & 0x00FF00FF, blendAmt) |
+          (blendLanes((color1 >> 8) & 0x00FF00FF, (color2 >> 8) & 0x00FF00FF, blendAmt) << 8);
+    }
 
   private:
+    // shallow copy, only used by the move constructor
+    WS2812FX(const WS2812FX&) = default;
+
+    // a registered custom mode
+    typedef struct CustomMode {
+      custom_mode_ptr fn;              // instance aware mode, or NULL
+      uint16_t (*legacy_fn)(void);     // mode using the global instance, or NULL
+      const __FlashStringHelper* name;
+      uint16_t state_size;             // bytes of per segment state the mode needs
+    } custom_mode;
+
+    // blend the two channels held in the 16-bit lanes of c1 and c2 (0x00XX00XX).
+    // Each lane adds the scaled difference when c2 > c1 or subtracts it when
+    // c2 < c1, so it rounds toward c1 like blendAmt * (c2 - c1) / 256 + c1.
+    static uint32_t blendLanes(uint32_t c1, uint32_t c2, uint8_t blendAmt) {
+      uint32_t up   = (c2 + 0x01000100) - c1; // 0x100 + c2 - c1 in each lane
+      uint32_t down = (c1 + 0x01000100) - c2;
+      uint32_t mask = ((up >> 8) & 0x00010001) * 0xFF; // 0xFF in the lanes where c2 >= c1
+      return c1 + ((((up & mask) * blendAmt) >> 8) & 0x00FF00FF)
+        - ((((down & ~mask & 0x00FF00FF) * blendAmt) >> 8) & 0x00FF00FF);
+    }
+
+    // a fixed frame delay of ms milliseconds, in the current segment's time
+    // units. TIME_MICROS delays saturate at 65535us.
+    uint16_t msDelay(uint16_t ms) {
+      return IS_TIME_MICROS ? (uint16_t)min(ms * 1000UL, 65535UL) : ms;
+    }
+
+    // runtime slot of an active segment, or INACTIVE_SEGMENT
+    uint8_t segmentSlot(uint8_t seg) const {
+      return seg < _segments_len ? _segment_slots[seg] : INACTIVE_SEGMENT;
+    }
+
+    // the custom mode registered for mode m, or NULL
+    const custom_mode* customMode(uint8_t m) const {
+      uint8_t index = m - FX_MODE_CUSTOM_0;
+      return (m >= FX_MODE_CUSTOM_0 && index < _custom_modes_len) ? &_custom_modes[index] : NULL;
+    }
+
+    // the lookup table the current segment's pixels are written through
+    const uint8_t* pixelLut(void) {
+      return _linear_buffer != NULL ? _identity_lut : (IS_GAMMA ? _gamma_bri_lut : _bri_lut);
+    }
+
+    void
+      applyLinearBuffer(void),
+      applyLinearRange(uint16_t first, uint16_t last, bool gamma),
+      updateLuts(void),
+      buildDeadlines(void),
+      siftDeadline(uint8_t i),
+      prepareModeState(uint8_t slot),
+      freePaletteWheels(void);
+
+    uint16_t runMode(void);
+
+    custom_mode* customModeSlot(uint8_t index);
+
+
+    uint32_t pixelHash(void);
+
     uint16_t _rand16seed;
-    uint16_t (*customModes[MAX_CUSTOM_MODES])(void) {
-      []{ return (uint16_t)1000; },
-      []{ return (uint16_t)1000; },
-      []{ return (uint16_t)1000; },
-      []{ return (uint16_t)1000; },
-      []{ return (uint16_t)1000; },
-      []{ return (uint16_t)1000; },
-      []{ return (uint16_t)1000; },
-      []{ return (uint16_t)1000; }
-    };
     void (*customShow)(void) = NULL;
 
     bool
       _running,
       _triggered;
 
-    segment* _segments;                 // array of segments (20 bytes per element)
+    segment* _segments;                 // array of segments (24 bytes per element)
     segment_runtime* _segment_runtimes; // array of segment runtimes (16 bytes per element)
     uint8_t* _active_segments;          // array of active segments (1 bytes per element)
+    uint8_t* _segment_slots;            // runtime slot of each segment, the inverse of _active_segments
 
     uint8_t _segments_len = 0;          // size of _segments array
     uint8_t _active_segments_len = 0;   // size of _segments_runtime and _active_segments arrays
     uint8_t _num_segments = 0;          // number of configured segments in the _segments array
 
-    segment* _seg;                      // currently active segment (20 bytes)
-    segment_runtime* _seg_rt;           // currently active segment runtime (16 bytes)
-
-    uint16_t _seg_len;                  // num LEDs in the currently active segment
+    // min-heap of active runtime slots, ordered by next_time. Each entry
+    // keeps a copy of its slot's next_time, so finding what's due and
+    // reordering the heap never has to load the (scattered) runtimes
+    typedef struct Deadline {
+      unsigned long next_time;
+      uint8_t slot;
+    } deadline;
+    deadline* _deadlines;
+    uint8_t _deadlines_len = 0;         // number of slots in the _deadlines heap
+    bool _deadlines_dirty = true;       // _deadlines must be rebuilt before it's used
+    uint8_t* _frame_segments;           // runtime slots rendered by the last service() call
+    uint8_t _frame_segments_len = 0;    // number of slots in _frame_segments
+
+    // which custom mode's state each runtime slot's MODE_STATE_SIZE bytes
+    // in _mode_state_data hold (see getModeState())
+    typedef struct ModeState {
+      uint16_t size;     // bytes the mode asked for
+      uint8_t mode;      // mode the state belongs to
+    } mode_state;
+    mode_state* _mode_states;           // one per runtime slot
+    uint8_t* _mode_state_data;          // MODE_STATE_SIZE bytes per runtime slot
+    void* _mode_state = NULL;           // state of the currently active segment
+
+    // registered custom modes, indexed by mode - FX_MODE_CUSTOM_0 and grown
+    // as modes are registered (see setCustomMode())
+    custom_mode* _custom_modes = NULL;
+    uint8_t _custom_modes_len = 0;      // number of registered custom mode slots
+    uint8_t _custom_modes_capacity = 0; // number of slots allocated
+
+    uint8_t* _segment_block = NULL;     // heap block holding the tables above, unless the caller provided one
+
+    uint16_t _refresh_rate = 0;         // global refresh rate in Hz (0 = show whenever a segment is due)
+    unsigned long _refresh_period = 0;  // 1000000 / _refresh_rate, in microseconds
+    unsigned long _next_refresh = 0;    // micros() time of the next refresh tick
+
+    segment* _seg = NULL;               // currently active segment (24 bytes)
+    segment_runtime* _seg_rt = NULL;    // currently active segment runtime (16 bytes)
+
+    uint16_t _seg_len = 0;              // num LEDs in the currently active segment
 
     uint8_t *drawBuffer;
     uint8_t bytesPerPixel;
+
+    // brightness is applied when pixels are written, through one of these
+    // lookup tables (rebuilt by setBrightness()), so WS2812Serial::show()
+    // runs at full brightness (or 0, to blank the strip)
+    uint8_t _brightness;
+    uint8_t _bri_lut[256];       // brightness scaling
+    uint8_t _gamma_bri_lut[256]; // gamma correction and brightness scaling
+
+    // optional buffer the effects draw into at full precision, copied to
+    // drawBuffer through the lookup tables by show() (see setLinearBuffer())
+    uint8_t* _linear_buffer = NULL;
+    uint8_t* _identity_lut = NULL;
+
+    uint32_t** _palette_wheels = NULL; // per segment color wheels expanded from palettes
+
+    // temporal dithering of the linear buffer (see setDithering())
+    bool _dithering = false;
+    uint16_t* _gamma16 = NULL;   // gamma correction, 8.8 fixed point
+    uint8_t _dither_frame = 0;
+    uint8_t _dither_threshold = 0;
+
+    // hash of the pixels service() last pushed out, so frames that didn't
+    // change anything don't need to be shown again
+    uint32_t _shown_hash = 0;
+    bool _shown_hash_valid = false;
+
+
+    bool _async_show = false;   // don't wait in service() for the previous frame to be sent
+    bool _show_pending = false; // a rendered frame is waiting for the serial port
 };
 
 class WS2812FXT {
@@ -775,72 +981,25 @@ class WS2812FXT {
     bool transitionDirection = true;
 };
 
-// define static array of member function pointers.
-// function pointers MUST be in the same order as the corresponding name in the _name array.
-static WS2812FX::mode_ptr _modes[MODE_COUNT] = {
-  &WS2812FX::mode_static,
-  &WS2812FX::mode_blink,
-  &WS2812FX::mode_breath,
-  &WS2812FX::mode_color_wipe,
-  &WS2812FX::mode_color_wipe_inv,
-  &WS2812FX::mode_color_wipe_rev,
-  &WS2812FX::mode_color_wipe_rev_inv,
-  &WS2812FX::mode_color_wipe_random,
-  &WS2812FX::mode_random_color,
-  &WS2812FX::mode_single_dynamic,
-  &WS2812FX::mode_multi_dynamic,
-  &WS2812FX::mode_rainbow,
-  &WS2812FX::mode_rainbow_cycle,
-  &WS2812FX::mode_scan,
-  &WS2812FX::mode_dual_scan,
-  &WS2812FX::mode_fade,
-  &WS2812FX::mode_theater_chase,
-  &WS2812FX::mode_theater_chase_rainbow,
-  &WS2812FX::mode_running_lights,
-  &WS2812FX::mode_twinkle,
-  &WS2812FX::mode_twinkle_random,
-  &WS2812FX::mode_twinkle_fade,
-  &WS2812FX::mode_twinkle_fade_random,
-  &WS2812FX::mode_sparkle,
-  &WS2812FX::mode_flash_sparkle,
-  &WS2812FX::mode_hyper_sparkle,
-  &WS2812FX::mode_strobe,
-  &WS2812FX::mode_strobe_rainbow,
-  &WS2812FX::mode_multi_strobe,
-  &WS2812FX::mode_blink_rainbow,
-  &WS2812FX::mode_chase_white,
-  &WS2812FX::mode_chase_color,
-  &WS2812FX::mode_chase_random,
-  &WS2812FX::mode_chase_rainbow,
-  &WS2812FX::mode_chase_flash,
-  &WS2812FX::mode_chase_flash_random,
-  &WS2812FX::mode_chase_rainbow_white,
-  &WS2812FX::mode_chase_blackout,
-  &WS2812FX::mode_chase_blackout_rainbow,
-  &WS2812FX::mode_color_sweep_random,
-  &WS2812FX::mode_running_color,
-  &WS2812FX::mode_running_red_blue,
-  &WS2812FX::mode_running_random,
-  &WS2812FX::mode_larson_scanner,
-  &WS2812FX::mode_comet,
-  &WS2812FX::mode_fireworks,
-  &WS2812FX::mode_fireworks_random,
-  &WS2812FX::mode_merry_christmas,
-  &WS2812FX::mode_fire_flicker,
-  &WS2812FX::mode_fire_flicker_soft,
-  &WS2812FX::mode_fire_flicker_intense,
-  &WS2812FX::mode_circus_combustus,
-  &WS2812FX::mode_halloween,
-  &WS2812FX::mode_bicolor_chase,
-  &WS2812FX::mode_tricolor_chase,
-  &WS2812FX::mode_twinkleFOX,
-  &WS2812FX::mode_custom_0,
-  &WS2812FX::mode_custom_1,
-  &WS2812FX::mode_custom_2,
-  &WS2812FX::mode_custom_3,
-  &WS2812FX::mode_custom_4,
-  &WS2812FX::mode_custom_5,
-  &WS2812FX::mode_custom_6,
-  &WS2812FX::mode_custom_7
-};
+/* Some palettes for setPalette(). PALETTE_PARTY has 16 evenly spaced colors
+   that wrap around the wheel, the others are gradients between color stops.
+*/
+static const uint32_t PROGMEM _PalettePartyColors[] = {
+  0x5500AB, 0x84007C, 0xB5004B, 0xE5001B, 0xE81700, 0xB84700, 0xAB7700, 0xABAB00,
+  0xAB5500, 0xDD2200, 0xF2000E, 0xC2003E, 0x8F0071, 0x5F00A1, 0x2F00D0, 0x0007F9 };
+static const WS2812FX::Palette PALETTE_PARTY = { 16, NULL, _PalettePartyColors };
+
+static const uint8_t  PROGMEM _PaletteHeatStops[]  = { 0, 128, 224, 255 };
+static const uint32_t PROGMEM _PaletteHeatColors[] = { 0x000000, 0xFF0000, 0xFFFF00, 0xFFFFFF };
+static const WS2812FX::Palette PALETTE_HEAT = { 4, _PaletteHeatStops, _PaletteHeatColors };
+
+static const uint8_t  PROGMEM _PaletteOceanStops[]  = { 0, 64, 128, 192, 255 };
+static const uint32_t PROGMEM _PaletteOceanColors[] = { 0x000040, 0x0000FF, 0x0080C0, 0x00FFFF, 0x000040 };
+static const WS2812FX::Palette PALETTE_OCEAN = { 5, _PaletteOceanStops, _PaletteOceanColors };
+
+static const uint8_t  PROGMEM _PaletteForestStops[]  = { 0, 96, 160, 255 };
+static const uint32_t PROGMEM _PaletteForestColors[] = { 0x004000, 0x00A000, 0x80C000, 0x004000 };
+static const WS2812FX::Palette PALETTE_FOREST = { 4, _PaletteForestStops, _PaletteForestColors };
+
+static_assert(MODE_COUNT == FX_MODE_CUSTOM_0, "custom modes must follow the builtin modes");
 #endif
@@ -37,16 +37,12 @@
 
 #include <WS2812FX.h>
 
-extern WS2812FX ws2812fx;
-
 const char bitsData[]  = "1110101111"; // pi=3.14
 
-uint16_t bits(void) {
-  WS2812FX::Segment* seg = ws2812fx.getSegment();
-  WS2812FX::Segment_runtime* segrt = ws2812fx.getSegmentRuntime();
+uint16_t bits(WS2812FX& ws2812fx, WS2812FX::Segment* seg, WS2812FX::Segment_runtime* segrt) {
   int seglen = seg->stop - seg->start + 1;
 
-  int8_t colorIndex = segrt->aux_param++;
+  segrt->aux_param++; // step the rainbow two places per frame
   uint8_t numBits = sizeof(bitsData) - 1;
   uint8_t ledsPerBit = seglen / (numBits * 2);
   //Serial.println(ledsPerBit);
@@ -3,6 +3,8 @@
   If you set the REVERSE option, an offset will be added to the comet after each
   cycle (so if the LEDs are arranged in a circle, the animation will appear to
   "walk" around the circle.)
+  Register it with a state size, so each segment walks on its own:
+    ws2812fx.setCustomMode(F("Dual Larson"), dualLarson, sizeof(DualLarsonState));
   
   Keith Lord - 2018
 
@@ -39,14 +41,17 @@
 
 #include <WS2812FX.h>
 
-extern WS2812FX ws2812fx;
+typedef struct DualLarsonState {
+  int16_t offset;
+} dual_larson_state;
 
-uint16_t dualLarson(void) {
-  WS2812FX::Segment* seg = ws2812fx.getSegment(); // get the current segment
-  WS2812FX::Segment_runtime* segrt = ws2812fx.getSegmentRuntime();
+uint16_t dualLarson(WS2812FX& ws2812fx, WS2812FX::Segment* seg, WS2812FX::Segment_runtime* segrt) {
   int seglen = seg->stop - seg->start + 1;
 
-  static int16_t offset = 0;
+  static DualLarsonState sharedState; // if registered without a state size, all segments share this
+  DualLarsonState* state = (DualLarsonState*)ws2812fx.getModeState();
+  if(state == NULL) state = &sharedState;
+  int16_t& offset = state->offset;
   int8_t dir = segrt->aux_param ? -1 : 1;
   segrt->aux_param3 += dir;
 
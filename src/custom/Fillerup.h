@@ -40,11 +40,7 @@
 
 #include <WS2812FX.h>
 
-extern WS2812FX ws2812fx;
-
-uint16_t fillerup(void) {
-  WS2812FX::Segment* seg = ws2812fx.getSegment(); // get the current segment
-  WS2812FX::Segment_runtime* segrt = ws2812fx.getSegmentRuntime();
+uint16_t fillerup(WS2812FX& ws2812fx, WS2812FX::Segment* seg, WS2812FX::Segment_runtime* segrt) {
   int seglen = seg->stop - seg->start + 1;
   bool isReverse = (seg->options & REVERSE) == REVERSE;
 
@@ -66,7 +62,7 @@ uint16_t fillerup(void) {
   segrt->counter_mode_step = (segrt->counter_mode_step + 1) % seglen;
 
   // when drop reaches the fill line, incr the fill line
-  if(segrt->counter_mode_step >= seglen - segrt->aux_param3 - 1) {
+  if(segrt->counter_mode_step >= (uint32_t)(seglen - segrt->aux_param3 - 1)) {
     segrt->aux_param3 += ((seg->options >> 1) & 3) + 1; // increment fill line by SIZE
     segrt->counter_mode_step = 0;
   }
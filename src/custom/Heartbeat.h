@@ -1,6 +1,8 @@
 /*
   Custom effect that creates a pulsing, heartbeat effect. It applies the
   FADE_RATE and SIZE options.
+  Register it with a state size, so each segment beats on its own:
+    ws2812fx.setCustomMode(F("Heartbeat"), heartbeat, sizeof(HeartbeatState));
   
   Keith Lord - 2020
 
@@ -41,14 +43,20 @@
 
 #include <WS2812FX.h>
 
-extern WS2812FX ws2812fx;
-void beatIt(WS2812FX::Segment*, uint8_t);
+void beatIt(WS2812FX&, WS2812FX::Segment*, uint8_t);
 
-uint16_t heartbeat(void) {
-  static unsigned long lastBeat = 0;
-  static bool secondBeatActive = false;
+typedef struct HeartbeatState {
+  unsigned long lastBeat;
+  bool secondBeatActive;
+} heartbeat_state;
+
+uint16_t heartbeat(WS2812FX& ws2812fx, WS2812FX::Segment* seg, WS2812FX::Segment_runtime* segrt) {
+  static HeartbeatState sharedState; // if registered without a state size, all segments share this
+  HeartbeatState* state = (HeartbeatState*)ws2812fx.getModeState();
+  if(state == NULL) state = &sharedState;
+  unsigned long& lastBeat = state->lastBeat;
+  bool& secondBeatActive = state->secondBeatActive;
 
-  WS2812FX::Segment* seg = ws2812fx.getSegment(); // get the current segment
   int seglen = seg->stop - seg->start + 1;
 
   // Get and translate the segment's size option
@@ -58,18 +66,19 @@ uint16_t heartbeat(void) {
   uint16_t bytesPerPixelBlock = size * ws2812fx.getNumBytesPerPixel();
   uint16_t centerOffset = (seglen / 2) * ws2812fx.getNumBytesPerPixel();
   uint16_t byteCount = centerOffset - bytesPerPixelBlock;
-  memmove(ws2812fx.getPixels(), ws2812fx.getPixels() + bytesPerPixelBlock, byteCount);
-  memmove(ws2812fx.getPixels() + centerOffset + bytesPerPixelBlock, ws2812fx.getPixels() + centerOffset, byteCount);
+  uint8_t* pixels = ws2812fx.getPixels() + seg->start * ws2812fx.getNumBytesPerPixel();
+  memmove(pixels, pixels + bytesPerPixelBlock, byteCount);
+  memmove(pixels + centerOffset + bytesPerPixelBlock, pixels + centerOffset, byteCount);
 
   ws2812fx.fade_out();
 
   unsigned long beatTimer = millis() - lastBeat;
   if((beatTimer > SECOND_BEAT) && !secondBeatActive) { // time for the second beat?
-    beatIt(seg, size); // create the second beat
+    beatIt(ws2812fx, seg, size); // create the second beat
     secondBeatActive = true;
   }
   if(beatTimer > MS_PER_BEAT) { // time to reset the beat timer?
-    beatIt(seg, size); // create the first beat
+    beatIt(ws2812fx, seg, size); // create the first beat
     secondBeatActive = false;
     lastBeat = millis();
     ws2812fx.setCycle();
@@ -79,7 +88,7 @@ uint16_t heartbeat(void) {
 }
 
 // light up ('size' * 2) LEDs in the middle of the segment (starts a beat)
-void beatIt(WS2812FX::Segment* seg, uint8_t size) {
+void beatIt(WS2812FX& ws2812fx, WS2812FX::Segment* seg, uint8_t size) {
   int seglen = seg->stop - seg->start + 1;
   uint16_t startLed = seg->start + (seglen / 2) - size;
   for (uint16_t i = startLed; i < startLed + (size * 2); i++) {
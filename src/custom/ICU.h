@@ -36,11 +36,7 @@
 
 #include <WS2812FX.h>
 
-extern WS2812FX ws2812fx;
-
-uint16_t icu(void) {
-  WS2812FX::Segment* seg = ws2812fx.getSegment(); // get the current segment
-  WS2812FX::Segment_runtime* segrt = ws2812fx.getSegmentRuntime();
+uint16_t icu(WS2812FX& ws2812fx, WS2812FX::Segment* seg, WS2812FX::Segment_runtime* segrt) {
   int seglen = seg->stop - seg->start + 1;
 
   uint16_t dest = segrt->counter_mode_step & 0xFFFF;
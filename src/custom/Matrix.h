@@ -56,15 +56,13 @@
 
 #include <WS2812FX.h>
 
-extern WS2812FX ws2812fx;
-
 struct Matrix {
   int8_t   numPages;
   int8_t   numRows;
   int8_t   numCols;
   uint32_t* colors;
 };
-struct Matrix _matrix; // global variable, so this custom effect shouldn't be used in more then one segment
+struct Matrix _matrix; // global configuration, every segment running this effect shows the same pages
 
 void configMatrix(uint8_t numPages, uint8_t numRows, uint8_t numCols, uint32_t* colors) {
   _matrix.numPages = numPages;
@@ -73,11 +71,7 @@ void configMatrix(uint8_t numPages, uint8_t numRows, uint8_t numCols, uint32_t*
   _matrix.colors = colors;
 }
 
-uint16_t matrix(void) {
-  WS2812FX::Segment* seg = ws2812fx.getSegment();
-  WS2812FX::Segment_runtime* segrt = ws2812fx.getSegmentRuntime();
-  int seglen = seg->stop - seg->start + 1;
-
+uint16_t matrix(WS2812FX& ws2812fx, WS2812FX::Segment* seg, WS2812FX::Segment_runtime* segrt) {
   uint16_t segIndex = seg->start;
   uint8_t pageIndex = segrt->aux_param * _matrix.numRows * _matrix.numCols; // aux_param will store the page index
   for(int rowIndex=0; rowIndex < _matrix.numRows; rowIndex++) {
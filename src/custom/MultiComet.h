@@ -1,5 +1,7 @@
 /*
   Custom effect that creates random comets
+  Register it with a state size, so each segment gets its own comets:
+    ws2812fx.setCustomMode(F("Multi Comet"), multiComet, sizeof(MultiCometState));
   
   Keith Lord - 2018
 
@@ -36,20 +38,28 @@
 
 #include <WS2812FX.h>
 
-extern WS2812FX ws2812fx;
+#define NUM_COMETS 6
 
-uint16_t multiComet(void) {
-  WS2812FX::Segment* seg = ws2812fx.getSegment(); // get the current segment
+typedef struct MultiCometState {
+  int16_t comets[NUM_COMETS];
+} multi_comet_state;
+
+uint16_t multiComet(WS2812FX& ws2812fx, WS2812FX::Segment* seg, WS2812FX::Segment_runtime* segrt) {
   int seglen = seg->stop - seg->start + 1;
 
   bool isReverse = (seg->options & REVERSE) == REVERSE;
 
   ws2812fx.fade_out();
 
-  static int16_t comets[] = {UINT16_MAX, UINT16_MAX, UINT16_MAX, UINT16_MAX, UINT16_MAX, UINT16_MAX};
-  static int8_t numComets = sizeof(comets)/sizeof(comets[0]);
+  static MultiCometState sharedState; // if registered without a state size, all segments share this
+  MultiCometState* state = (MultiCometState*)ws2812fx.getModeState();
+  if(state == NULL) state = &sharedState;
+  int16_t* comets = state->comets;
+  if(segrt->counter_mode_call == 0) { // first frame, no comets yet
+    for(uint8_t i=0; i < NUM_COMETS; i++) comets[i] = INT16_MAX;
+  }
 
-  for(uint8_t i=0; i < numComets; i++) {
+  for(uint8_t i=0; i < NUM_COMETS; i++) {
     if(comets[i] < seglen) {
       if(isReverse) {
         ws2812fx.setPixelColor(seg->stop - comets[i],  i % 2 ? seg->colors[0] : seg->colors[2]);
@@ -1,5 +1,7 @@
 /*
   Custom effect that creates three color spans that oscillate back and forth.
+  Register it with a state size, so each segment gets its own oscillators:
+    ws2812fx.setCustomMode(F("Oscillate"), oscillate, sizeof(OscillateState));
   
   Keith Lord - 2018
 
@@ -36,8 +38,6 @@
 
 #include <WS2812FX.h>
 
-extern WS2812FX ws2812fx;
-
 typedef struct Oscillator {
   int16_t pos;
   int8_t  size;
@@ -45,17 +45,26 @@ typedef struct Oscillator {
   int8_t  speed;
 } oscillator;
 
-uint16_t oscillate(void) {
-  WS2812FX::Segment* seg = ws2812fx.getSegment(); // get the current segment
+#define NUM_OSCILLATORS 3
+
+typedef struct OscillateState {
+  oscillator oscillators[NUM_OSCILLATORS];
+} oscillate_state;
+
+uint16_t oscillate(WS2812FX& ws2812fx, WS2812FX::Segment* seg, WS2812FX::Segment_runtime* segrt) {
   int seglen = seg->stop - seg->start + 1;
 
-  static oscillator oscillators[] = {
-    {seglen/4,   seglen/8,  1, 1},
-    {seglen/4*2, seglen/8, -1, 1},
-    {seglen/4*3, seglen/8,  1, 2}
-  };
+  static OscillateState sharedState; // if registered without a state size, all segments share this
+  OscillateState* state = (OscillateState*)ws2812fx.getModeState();
+  if(state == NULL) state = &sharedState;
+  oscillator* oscillators = state->oscillators;
+  if(segrt->counter_mode_call == 0) { // first frame, spread the oscillators over the segment
+    oscillators[0] = {(int16_t)(seglen/4),   (int8_t)(seglen/8),  1, 1};
+    oscillators[1] = {(int16_t)(seglen/4*2), (int8_t)(seglen/8), -1, 1};
+    oscillators[2] = {(int16_t)(seglen/4*3), (int8_t)(seglen/8),  1, 2};
+  }
 
-  for(int8_t i=0; i < sizeof(oscillators)/sizeof(oscillators[0]); i++) {
+  for(int8_t i=0; i < NUM_OSCILLATORS; i++) {
     oscillators[i].pos += oscillators[i].dir * oscillators[i].speed;
     if((oscillators[i].dir == -1) && (oscillators[i].pos <= 0)) {
       oscillators[i].pos = 0;
@@ -73,7 +82,7 @@ uint16_t oscillate(void) {
 
   for(int16_t i=0; i < seglen; i++) {
     uint32_t color = BLACK;
-    for(int8_t j=0; j < sizeof(oscillators)/sizeof(oscillators[0]); j++) {
+    for(int8_t j=0; j < NUM_OSCILLATORS; j++) {
       if(i >= oscillators[j].pos - oscillators[j].size && i <= oscillators[j].pos + oscillators[j].size) {
         color = (color == BLACK) ? seg->colors[j] : ws2812fx.color_blend(color, seg->colors[j], 128);
       }
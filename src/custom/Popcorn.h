@@ -2,6 +2,8 @@
   Custom effect that looks like popcorn.
   The 'popcorn' is color[0] and the background color is color[1].
   If color[0] is the same as color[1], the 'popcorn' will be a random color.
+  Register it with a state size, so each segment gets its own popcorn:
+    ws2812fx.setCustomMode(F("Popcorn"), popcorn, sizeof(PopcornState));
   
   Keith Lord - 2018
 
@@ -41,26 +43,30 @@
 #define MAX_NUM_POPCORN 10
 #define GRAVITY 0.1
 
-extern WS2812FX ws2812fx;
-
 typedef struct Kernel {
   float position;
   float velocity;
   int32_t color;
 } kernel;
 
-uint16_t popcorn(void) {
-  WS2812FX::Segment* seg = ws2812fx.getSegment(); // get the current segment
+typedef struct PopcornState {
+  kernel popcorn[MAX_NUM_POPCORN];
+  float coeff;
+} popcorn_state;
+
+uint16_t popcorn(WS2812FX& ws2812fx, WS2812FX::Segment* seg, WS2812FX::Segment_runtime* segrt) {
   uint16_t seglen = seg->stop - seg->start + 1;
   uint32_t popcornColor = seg->colors[0];
   uint32_t bgColor = seg->colors[1];
   if(popcornColor == bgColor) popcornColor = ws2812fx.color_wheel(ws2812fx.random8());
   bool isReverse = (seg->options & REVERSE) != 0;
 
-  static kernel popcorn[MAX_NUM_POPCORN];
-  static float coeff = 0.0f;
-  if(coeff == 0.0f) { // calculate the velocity coeff once (the secret sauce)
-    coeff = pow((float)seglen, 0.5223324f) * 0.3944296f;
+  static PopcornState sharedState; // if registered without a state size, all segments share this
+  PopcornState* state = (PopcornState*)ws2812fx.getModeState();
+  if(state == NULL) state = &sharedState;
+  kernel* popcorn = state->popcorn;
+  if(state->coeff == 0.0f) { // calculate the velocity coeff once (the secret sauce)
+    state->coeff = pow((float)seglen, 0.5223324f) * 0.3944296f;
   }
 
   // reset all LEDs to background color
@@ -80,7 +86,7 @@ uint16_t popcorn(void) {
     } else { // if kernel is inactive, randomly pop it
       if(ws2812fx.random8() < 2) { // POP!!!
         popcorn[i].position = 0.0f;
-        popcorn[i].velocity = coeff * (random(66, 100) / 100.0f);
+        popcorn[i].velocity = state->coeff * (random(66, 100) / 100.0f);
         popcorn[i].color = popcornColor;
         ledIndex = isReverse ? seg->stop : seg->start;
         ws2812fx.setPixelColor(ledIndex, popcorn[i].color);
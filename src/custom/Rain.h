@@ -42,10 +42,7 @@
 
 #include <WS2812FX.h>
 
-extern WS2812FX ws2812fx;
-
-uint16_t rain(void) {
-  WS2812FX::Segment* seg = ws2812fx.getSegment(); // get the current segment
+uint16_t rain(WS2812FX& ws2812fx, WS2812FX::Segment* seg, WS2812FX::Segment_runtime* segrt) {
   uint16_t seglen = seg->stop - seg->start + 1;
   uint32_t rainColor = (ws2812fx.random8() & 1) == 0 ? seg->colors[0] : seg->colors[2];
   if(seg->colors[0] == seg->colors[1]) rainColor = ws2812fx.color_wheel(ws2812fx.random8());
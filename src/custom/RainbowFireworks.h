@@ -37,10 +37,7 @@
 
 #include <WS2812FX.h>
 
-extern WS2812FX ws2812fx;
-
-uint16_t rainbowFireworks(void) {
-  WS2812FX::Segment* seg = ws2812fx.getSegment(); // get the current segment
+uint16_t rainbowFireworks(WS2812FX& ws2812fx, WS2812FX::Segment* seg, WS2812FX::Segment_runtime* segrt) {
   uint16_t seglen = seg->stop - seg->start + 1;
 
   ws2812fx.setBrightness(255); // force full brightness
@@ -44,11 +44,7 @@
 
 #define DIR_BIT (uint8_t)B00000001 // segrt->aux_param2 direction bit
 
-extern WS2812FX ws2812fx;
-
-uint16_t rainbowLarson(void) {
-  WS2812FX::Segment* seg = ws2812fx.getSegment(); // get the current segment
-  WS2812FX::Segment_runtime* segrt = ws2812fx.getSegmentRuntime();
+uint16_t rainbowLarson(WS2812FX& ws2812fx, WS2812FX::Segment* seg, WS2812FX::Segment_runtime* segrt) {
   int seglen = seg->stop - seg->start + 1;
 
   int8_t dir = ((segrt->aux_param2 & DIR_BIT) == DIR_BIT) ? -1 : 1; // forward?
@@ -36,11 +36,7 @@
 
 #include <WS2812FX.h>
 
-extern WS2812FX ws2812fx;
-
-uint16_t randomChase(void) {
-  WS2812FX::Segment* seg = ws2812fx.getSegment();
-  WS2812FX::Segment_runtime* segrt = ws2812fx.getSegmentRuntime();
+uint16_t randomChase(WS2812FX& ws2812fx, WS2812FX::Segment* seg, WS2812FX::Segment_runtime* segrt) {
   int seglen = seg->stop - seg->start + 1;
 
   ws2812fx.copyPixels(seg->start + 1, seg->start, seglen - 1);
@@ -39,11 +39,7 @@
 
 #include <WS2812FX.h>
 
-extern WS2812FX ws2812fx;
-
-uint16_t triFade(void) {
-  WS2812FX::Segment* seg = ws2812fx.getSegment(); // get the current segment
-  WS2812FX::Segment_runtime* segrt = ws2812fx.getSegmentRuntime();
+uint16_t triFade(WS2812FX& ws2812fx, WS2812FX::Segment* seg, WS2812FX::Segment_runtime* segrt) {
 
   uint8_t options = seg->options;
   bool trifade_black = (options & TRIFADE_BLACK) == TRIFADE_BLACK;
@@ -43,12 +43,8 @@ be removed from the custom folder.
 
 #include <WS2812FX.h>
 
-extern WS2812FX ws2812fx;
-
-uint16_t twinkleFox(void) {
+uint16_t twinkleFox(WS2812FX& ws2812fx, WS2812FX::Segment* seg, WS2812FX::Segment_runtime* segrt) {
   uint16_t mySeed = 0; // reset the random number generator seed
-  WS2812FX::Segment* seg = ws2812fx.getSegment(); // get the current segment
-  WS2812FX::Segment_runtime* segrt = ws2812fx.getSegmentRuntime();
 
   // Get and translate the segment's size option
   uint8_t size = 1 << ((seg->options >> 1) & 0x03); // 1,2,4,8
@@ -73,7 +69,7 @@ uint16_t twinkleFox(void) {
     // Use the counter_mode_call var as a clock "tick" counter and calc the blend index
     uint8_t blendIndex = (initValue + (segrt->counter_mode_call * incrValue)) & 0xff; // 0-255
     // Index into the built-in sine table to lookup the blend amount
-    uint8_t blendAmt = sine8(blendIndex); // 0-255
+    uint8_t blendAmt = WS2812FX::sine8(blendIndex); // 0-255
 
     // If colors[0] is BLACK, blend random colors
     if(color0 == BLACK) {
@@ -46,12 +46,9 @@
   #define USE_RANDOM_DATA true
 #endif
 
-extern WS2812FX ws2812fx;
-
 uint8_t vuMeterBands[NUM_BANDS]; // global VU meter band amplitude data (range 0-255)
 
-uint16_t vuMeter(void) {
-  WS2812FX::Segment* seg = ws2812fx.getSegment();
+uint16_t vuMeter(WS2812FX& ws2812fx, WS2812FX::Segment* seg, WS2812FX::Segment_runtime* segrt) {
   uint16_t seglen = seg->stop - seg->start + 1;
   uint16_t bandSize = seglen / NUM_BANDS;
 